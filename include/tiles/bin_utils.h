@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace tiles {
 
 template <typename T>
@@ -35,4 +40,15 @@ inline bool bit_set(uint32_t val, uint32_t idx) {
   return (val & (1 << idx)) != 0;
 }
 
+// index of the lowest set bit (val must not be zero)
+inline uint32_t trailing_zeros(uint64_t const val) {
+#ifdef _MSC_VER
+  unsigned long idx = 0;
+  _BitScanForward64(&idx, val);
+  return static_cast<uint32_t>(idx);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(val));
+#endif
+}
+
 }  // namespace tiles
\ No newline at end of file
@@ -8,4 +8,7 @@ constexpr auto kTileSize = 4096;
 using proj = geo::webmercator<kTileSize, 20>;
 constexpr auto kMaxZoomLevel = proj::kMaxZoomLevel;
 
+// one screen pixel (256px raster tile) in vector tile units: (4096 / 256)^2
+constexpr uint32_t kScreenPixelAreaLog2 = 8;
+
 }  // namespace tiles
@@ -10,6 +10,18 @@ namespace tiles {
 
 using bq_node_t = uint32_t;
 
+constexpr auto const kBQFlatZoomLvl = 10U;
+
+// optional flattened representation of a bq_tree (see bq_tree::flatten)
+// - full_: tiles on level z_ which are covered by a TRUE leaf (bitmap)
+// - partial_: tiles on level z_ with TRUE leafs on deeper levels (bitmap)
+// - deep_leafs_: the TRUE leafs deeper than z_ sorted by morton code
+struct bq_flat_index {
+  uint32_t z_;
+  std::vector<bool> full_, partial_;
+  std::vector<std::pair<uint64_t, geo::tile>> deep_leafs_;
+};
+
 struct bq_tree {
   bq_tree();
   explicit bq_tree(std::string_view);
@@ -18,6 +30,10 @@ struct bq_tree {
   bool contains(geo::tile const& q) const;
   std::vector<geo::tile> all_leafs(geo::tile const& q) const;
 
+  // builds the flat index: queries on levels >= z become bit tests and range
+  // scans instead of walking the tree from the root
+  void flatten(uint32_t z = kBQFlatZoomLvl);
+
   std::string_view string_view() const;
   void dump() const;
 
@@ -27,8 +43,13 @@ private:
   std::pair<std::optional<bool>, bq_node_t> find_parent_leaf(
       geo::tile const& q) const;
 
+  std::optional<bool> flat_contains(geo::tile const& q) const;
+  std::optional<std::vector<geo::tile>> flat_all_leafs(
+      geo::tile const& q) const;
+
 public:
   std::vector<bq_node_t> nodes_;
+  std::optional<bq_flat_index> flat_;
 };
 
 bq_tree make_bq_tree(std::vector<geo::tile> const&);
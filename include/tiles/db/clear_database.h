@@ -13,6 +13,9 @@ inline void clear_database(tile_db_handle& handle, lmdb::txn& txn) {
 
   auto tiles_dbi = handle.tiles_dbi(txn, lmdb::dbi_flags::CREATE);
   txn.dbi_clear(tiles_dbi);
+
+  auto pyramid_dbi = handle.pyramid_dbi(txn, lmdb::dbi_flags::CREATE);
+  txn.dbi_clear(pyramid_dbi);
 }
 
 inline void clear_database(std::string const& db_fname) {
@@ -32,20 +32,32 @@ struct feature_inserter_mt {
   static constexpr size_t kCacheThresholdLower = kCacheThresholdUpper / 4 * 3;
 
   feature_inserter_mt(dbi_handle dbi_handle, pack_handle& pack_handle)
-      : dbi_handle_{std::move(dbi_handle)},
-        pack_handle_{pack_handle},
-        cache_((1ULL << kTileDefaultIndexZoomLvl) *
-               (1ULL << kTileDefaultIndexZoomLvl)) {
-    auto it = geo::tile_iterator{kTileDefaultIndexZoomLvl};
-    for (auto& c : cache_) {
-      utl::verify(it->z_ == kTileDefaultIndexZoomLvl, "it broken");
-      c.tile_ = *it;
-      ++it;
+      : dbi_handle_{std::move(dbi_handle)}, pack_handle_{pack_handle} {
+    auto size = 0ULL;
+    for (auto const z : kTileIndexZoomLvls) {
+      size += (1ULL << z) * (1ULL << z);
+    }
+
+    cache_ = std::vector<cache_bucket>(size);
+    auto c = begin(cache_);
+    for (auto const z : kTileIndexZoomLvls) {
+      auto it = geo::tile_iterator{z};
+      for (auto i = 0ULL; i < (1ULL << z) * (1ULL << z); ++i, ++c, ++it) {
+        utl::verify(it->z_ == z, "it broken");
+        c->tile_ = *it;
+      }
+      utl::verify(it->z_ == z + 1, "it broken");
     }
-    utl::verify(it->z_ == kTileDefaultIndexZoomLvl + 1, "it broken");
   }
 
-  ~feature_inserter_mt() { flush(0, 0); }
+  ~feature_inserter_mt() {
+    flush(0, 0);
+    if (large_features_ != 0) {
+      t_log("large features: {} on a coarser index level ({} copies saved)",
+            printable_num{large_features_.load()},
+            printable_bytes{large_features_saved_.load()});
+    }
+  }
 
   feature_inserter_mt(feature_inserter_mt const&) = delete;
   feature_inserter_mt(feature_inserter_mt&&) noexcept = delete;
@@ -54,10 +66,19 @@ struct feature_inserter_mt {
 
   geo::tile insert(feature const& f) {
     auto const box = bounding_box(f.geometry_);
-    auto const range = make_tile_range(box);
+    auto const z = index_zoom_level(box, f.zoom_levels_.first);
+    auto const range = make_tile_range(box, z);
     utl::verify(range.begin() != range.end(), "inserter: no tile for feature");
 
     auto const value = serialize_feature(f);
+
+    if (auto const default_z = index_zoom_level(f.zoom_levels_.first);
+        z != default_z) {
+      ++large_features_;
+      large_features_saved_ +=
+          value.size() *
+          (index_tile_count(box, default_z) - index_tile_count(box, z));
+    }
     for (auto const& tile : range) {
       insert(tile, value);
     }
@@ -157,7 +178,8 @@ struct feature_inserter_mt {
   cache_bucket& get_bucket(geo::tile const tile) {
     auto it = std::lower_bound(
         begin(cache_), end(cache_), tile, [](auto const& a, auto const& b) {
-          return std::tie(a.tile_.y_, a.tile_.x_) < std::tie(b.y_, b.x_);
+          return std::tie(a.tile_.z_, a.tile_.y_, a.tile_.x_) <
+                 std::tie(b.z_, b.y_, b.x_);
         });
 
     utl::verify(it != end(cache_) && tile == it->tile_,
@@ -170,6 +192,9 @@ struct feature_inserter_mt {
 
   std::mutex flush_mutex_;
   std::atomic_size_t cache_size_{0};
+
+  std::atomic_size_t large_features_{0};
+  std::atomic_size_t large_features_saved_{0};  // bytes
   std::vector<cache_bucket> cache_;
 };
 
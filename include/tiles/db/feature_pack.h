@@ -1,15 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "protozero/varint.hpp"
 
+#include "utl/to_vec.h"
+
 #include "tiles/bin_utils.h"
+#include "tiles/db/hilbert_rtree.h"
+#include "tiles/db/pack_compression.h"
 #include "tiles/db/quad_tree.h"
+#include "tiles/fixed/fixed_geometry.h"
 
-// FEATURE PACK "WIRE FORMAT" SPECIFICATION v2.1
+// FEATURE PACK "WIRE FORMAT" SPECIFICATION v2.5
 //
 // A feature pack is intended to hold serialized feature data for features in
 // one "bucket" of the toplevel geo index.
@@ -22,6 +30,11 @@
 //
 // TYPE ID VALUES:
 //    0x0: quad tree index
+//    0x1: compressed pack (see pack_compression.h)
+//    0x2: feature table (see below)
+//    0x3: zoom range index (see below)
+//    0x4: feature boxes (see below)
+//    0x5: packed hilbert r-tree index (see hilbert_rtree.h)
 //
 //  The pack starts with the header at offset 0x0.
 //
@@ -50,10 +63,50 @@
 //
 // The last four bytes of the feature pack are a crc32 checksum of the entire
 // feature pack (obviously excluding the checksum itself).
+//
+// FEATURE TABLE LAYOUT (fixed size entries -> random access to feature i):
+//  4b : uint32_t : feature count n
+//  4b : uint32_t : feature 0 offset (of its size prefix)
+//  1b : uint8_t  : feature 0 min zoom level
+//  1b : uint8_t  : feature 0 max zoom level
+//    ...
+//
+// ZOOM RANGE INDEX LAYOUT:
+// The first tree of the quad tree index holds all features with a min zoom
+// level <= the zoom level of the pack root. The zoom range index has the same
+// layout as the quad tree index, but one tree per min zoom level in
+// [0, root z] for exactly these features. Readers may use it to skip features
+// which are not visible on lower zoom levels.
+//
+// FEATURE BOXES LAYOUT (columns in feature table order, see
+// feature_pack_filter.h):
+//  4b     : uint32_t : feature count n
+//  n * 1b : uint8_t  : min zoom levels
+//  n * 1b : uint8_t  : max zoom levels
+//  n * 4b : uint32_t : min x of the bounding boxes (z20 fixed coordinates)
+//  n * 4b : uint32_t : min y
+//  n * 4b : uint32_t : max x
+//  n * 4b : uint32_t : max y
 
 namespace tiles {
 
 constexpr auto const kQuadTreeFeatureIndexId = 0x0;
+constexpr auto const kCompressedPackId = 0x1;
+constexpr auto const kFeatureTableId = 0x2;
+constexpr auto const kZoomRangeIndexId = 0x3;
+constexpr auto const kFeatureBoxesId = 0x4;
+constexpr auto const kHilbertRTreeIndexId = 0x5;
+
+// spatial index of the packs: unpack_features (and render_features, instead of
+// the box prefilter) prefer the hilbert r-tree (written in addition to the
+// quad tree) if it is present
+enum class pack_index : uint8_t { quad_tree = 0, hilbert_rtree = 1 };
+
+char const* to_str(pack_index);
+pack_index parse_pack_index(std::string_view);
+
+constexpr auto const kFeatureTableEntrySize =
+    sizeof(uint32_t) + 2 * sizeof(uint8_t);
 
 struct feature_packer {
   void register_segment(uint8_t const id) {
@@ -92,12 +145,67 @@ struct feature_packer {
     return offset;
   }
 
-  void append_feature(std::string const& feature) {
+  void append_feature(std::string const& feature,
+                      std::pair<uint32_t, uint32_t> const zoom_levels = {
+                          0U, std::numeric_limits<uint8_t>::max()},
+                      fixed_box const& box = {{kFixedCoordMin, kFixedCoordMin},
+                                              {kFixedCoordMax,
+                                               kFixedCoordMax}}) {
     utl::verify(feature.size() >= 32, "MINI FEATURE?!");
+    feature_table_.push_back({static_cast<uint32_t>(buf_.size()),
+                              static_cast<uint8_t>(zoom_levels.first),
+                              static_cast<uint8_t>(zoom_levels.second), box});
     protozero::write_varint(std::back_inserter(buf_), feature.size());
     buf_.append(feature.data(), feature.size());
   }
 
+  // requires a registered kFeatureTableId segment
+  void append_feature_table() {
+    utl::verify(feature_table_.size() <= std::numeric_limits<uint32_t>::max(),
+                "packer.append_feature_table: too many features");
+    update_segment_offset(kFeatureTableId,
+                          static_cast<uint32_t>(buf_.size()));
+    tiles::append<uint32_t>(buf_, feature_table_.size());
+    for (auto const& e : feature_table_) {
+      tiles::append<uint32_t>(buf_, e.offset_);
+      tiles::append<uint8_t>(buf_, e.min_z_);
+      tiles::append<uint8_t>(buf_, e.max_z_);
+    }
+  }
+
+  // requires a registered kFeatureBoxesId segment
+  void append_feature_boxes() {
+    update_segment_offset(kFeatureBoxesId, static_cast<uint32_t>(buf_.size()));
+    tiles::append<uint32_t>(buf_, feature_table_.size());
+    for (auto const& e : feature_table_) {
+      tiles::append<uint8_t>(buf_, e.min_z_);
+    }
+    for (auto const& e : feature_table_) {
+      tiles::append<uint8_t>(buf_, e.max_z_);
+    }
+
+    auto const append_coords = [&](auto&& get) {
+      for (auto const& e : feature_table_) {
+        tiles::append<uint32_t>(
+            buf_, static_cast<uint32_t>(
+                      std::clamp(get(e.box_), kFixedCoordMin, kFixedCoordMax)));
+      }
+    };
+    append_coords([](auto const& b) { return b.min_corner().x(); });
+    append_coords([](auto const& b) { return b.min_corner().y(); });
+    append_coords([](auto const& b) { return b.max_corner().x(); });
+    append_coords([](auto const& b) { return b.max_corner().y(); });
+  }
+
+  // requires a registered kHilbertRTreeIndexId segment
+  void append_hilbert_rtree() {
+    auto const input = utl::to_vec(feature_table_, [](auto const& e) {
+      return hilbert_rtree_input{e.box_, e.offset_, {e.min_z_, e.max_z_}};
+    });
+    update_segment_offset(kHilbertRTreeIndexId,
+                          append(make_hilbert_rtree(input)));
+  }
+
   void append_span_end() {
     protozero::write_varint(std::back_inserter(buf_),
                             0ULL);  // null terminated
@@ -120,8 +228,15 @@ struct feature_packer {
 
   void finish();
 
+  struct feature_table_entry {
+    uint32_t offset_;
+    uint8_t min_z_, max_z_;
+    fixed_box box_;
+  };
+
   std::string buf_;
   std::map<uint8_t, uint32_t> segment_offsets_;
+  std::vector<feature_table_entry> feature_table_;
 };
 
 bool feature_pack_valid(std::string_view);
@@ -139,6 +254,61 @@ inline std::optional<uint32_t> find_segment_offset(std::string_view const pack,
   return offset;
 }
 
+// view of the feature table segment (see wire format)
+struct feature_table {
+  feature_table(std::string_view const pack, uint32_t const offset)
+      : pack_{pack}, offset_{offset} {
+    utl::verify(pack_.size() >= offset_ + sizeof(uint32_t) &&
+                    pack_.size() >= offset_ + sizeof(uint32_t) +
+                                        size() * kFeatureTableEntrySize,
+                "feature_table: invalid offset");
+  }
+
+  size_t size() const { return read<uint32_t>(pack_.data(), offset_); }
+
+  std::string_view feature(size_t const i) const {
+    auto ptr = pack_.data() + read<uint32_t>(pack_.data(), entry(i));
+    auto const size =
+        protozero::decode_varint(&ptr, pack_.data() + pack_.size());
+    return std::string_view{ptr, size};
+  }
+
+  std::pair<uint32_t, uint32_t> zoom_levels(size_t const i) const {
+    auto const e = entry(i) + sizeof(uint32_t);
+    return {read<uint8_t>(pack_.data(), e),
+            read<uint8_t>(pack_.data(), e + sizeof(uint8_t))};
+  }
+
+  size_t entry(size_t const i) const {
+    return offset_ + sizeof(uint32_t) + i * kFeatureTableEntrySize;
+  }
+
+  std::string_view pack_;
+  uint32_t offset_;
+};
+
+inline std::optional<feature_table> find_feature_table(
+    std::string_view const pack) {
+  auto const offset = find_segment_offset(pack, kFeatureTableId);
+  return offset ? std::optional<feature_table>{feature_table{pack, *offset}}
+                : std::nullopt;
+}
+
+// features [begin, end) which exist on zoom level z, without parsing them
+// (e.g. to split one pack between threads)
+template <typename Fn>
+void unpack_features(feature_table const& table, size_t const begin,
+                     size_t const end, uint32_t const z, Fn&& fn) {
+  utl::verify(begin <= end && end <= table.size(),
+              "unpack_features: invalid range");
+  for (auto i = begin; i < end; ++i) {
+    auto const [min_z, max_z] = table.zoom_levels(i);
+    if (min_z <= z && z <= max_z) {
+      fn(table.feature(i));
+    }
+  }
+}
+
 template <typename Fn>
 size_t unpack_features(std::string_view const& string, Fn&& fn) {
   utl::verify(string.size() >= 5, "unpack_features: invalid feature_pack");
@@ -158,10 +328,26 @@ size_t unpack_features(std::string_view const& string, Fn&& fn) {
   return std::distance(string.data(), ptr);
 }
 
+// box: query box of the tile (e.g. tile_spec::draw_bounds_) for the r-tree
 template <typename Fn>
 void unpack_features(geo::tile const& root, std::string_view const& string,
-                     geo::tile const& tile, Fn&& fn) {
+                     geo::tile const& tile, fixed_box const& box, Fn&& fn) {
   utl::verify(string.size() >= 5, "unpack_features: invalid feature_pack");
+  auto const end = string.data() + string.size();
+  if (auto const rtree_offset =
+          find_segment_offset(string, kHilbertRTreeIndexId);
+      rtree_offset) {
+    utl::verify(string.size() >= *rtree_offset,
+                "invalid feature_pack rtree_offset");
+    walk_hilbert_rtree(string.data() + *rtree_offset, box, tile.z_,
+                       [&](uint32_t const feature_offset) {
+                         auto ptr = string.data() + feature_offset;
+                         auto const size = protozero::decode_varint(&ptr, end);
+                         fn(std::string_view{ptr, size});
+                       });
+    return;
+  }
+
   auto const idx_offset = find_segment_offset(string, kQuadTreeFeatureIndexId);
   if (!idx_offset) {
     unpack_features(string, fn);  // no quad tree available, fallback
@@ -169,12 +355,9 @@ void unpack_features(geo::tile const& root, std::string_view const& string,
   }
 
   utl::verify(string.size() >= *idx_offset, "invalid feature_pack idx_offset");
-  auto idx_ptr = string.data() + *idx_offset;
-  auto const end = string.data() + string.size();
-  for (auto z = root.z_; z <= std::max(root.z_, tile.z_); ++z) {
-    auto const tree_offset = protozero::decode_varint(&idx_ptr, end);
+  auto const walk_tree = [&](auto const tree_offset) {
     if (tree_offset == 0) {
-      continue;  // index empty
+      return;  // index empty
     }
 
     walk_quad_tree(
@@ -189,6 +372,28 @@ void unpack_features(geo::tile const& root, std::string_view const& string,
             }
           }
         });
+  };
+
+  auto idx_ptr = string.data() + *idx_offset;
+  for (auto z = root.z_; z <= std::max(root.z_, tile.z_); ++z) {
+    auto const tree_offset = protozero::decode_varint(&idx_ptr, end);
+    if (z != root.z_) {
+      walk_tree(tree_offset);
+      continue;
+    }
+
+    auto const zoom_offset = find_segment_offset(string, kZoomRangeIndexId);
+    if (!zoom_offset) {
+      walk_tree(tree_offset);  // no zoom range index available, fallback
+      continue;
+    }
+
+    utl::verify(string.size() >= *zoom_offset,
+                "invalid feature_pack zoom_offset");
+    auto zoom_ptr = string.data() + *zoom_offset;
+    for (auto min_z = 0U; min_z <= std::min(root.z_, tile.z_); ++min_z) {
+      walk_tree(protozero::decode_varint(&zoom_ptr, end));
+    }
   }
 }
 
@@ -201,10 +406,13 @@ std::string pack_features(std::vector<std::string> const&);
 
 // optimal packing (incl. index)
 std::string pack_features(geo::tile const&, shared_metadata_coder const&,
-                          std::vector<std::string> const&);
+                          std::vector<std::string> const&,
+                          pack_index = pack_index::quad_tree);
 
 // full database packing (e.g. once and optimal)
-void pack_features(tile_db_handle&, pack_handle&);
+void pack_features(tile_db_handle&, pack_handle&,
+                   pack_codec = pack_codec::none,
+                   pack_index = pack_index::quad_tree);
 
 // full database packing (with custom packing function)
 void pack_features(
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "tiles/bin_utils.h"
+#include "tiles/db/feature_pack.h"
+#include "tiles/fixed/fixed_geometry.h"
+
+namespace tiles {
+
+// bit i % 64 of word i / 64 <=> feature i of the feature table
+using feature_selection = std::vector<uint64_t>;
+
+// evaluates the feature boxes segment against box and zoom level in one pass
+// (plain loops over the columns, written to be auto-vectorized)
+// nullopt: pack without feature boxes segment
+std::optional<feature_selection> select_features(std::string_view pack,
+                                                 fixed_box const& box,
+                                                 uint32_t z);
+
+// false: pack without feature table or feature boxes, use the quad tree
+template <typename Fn>
+bool unpack_selected_features(std::string_view const pack,
+                              fixed_box const& box, uint32_t const z,
+                              Fn&& fn) {
+  auto const table = find_feature_table(pack);
+  if (!table) {
+    return false;
+  }
+  auto const selection = select_features(pack, box, z);
+  if (!selection) {
+    return false;
+  }
+
+  for (auto i = 0ULL; i < selection->size(); ++i) {
+    for (auto bits = (*selection)[i]; bits != 0; bits &= bits - 1) {
+      fn(table->feature(i * 64 + trailing_zeros(bits)));
+    }
+  }
+  return true;
+}
+
+}  // namespace tiles
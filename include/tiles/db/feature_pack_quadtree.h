@@ -28,9 +28,16 @@ struct quadtree_feature {
 
 struct quadtree_feature_packer {
   quadtree_feature_packer(geo::tile root,
-                          shared_metadata_coder const& metadata_coder)
-      : root_{root}, metadata_coder_{metadata_coder} {
+                          shared_metadata_coder const& metadata_coder,
+                          pack_index const index = pack_index::quad_tree)
+      : root_{root}, metadata_coder_{metadata_coder}, index_{index} {
     packer_.register_segment(kQuadTreeFeatureIndexId);
+    packer_.register_segment(kFeatureTableId);
+    packer_.register_segment(kZoomRangeIndexId);
+    packer_.register_segment(kFeatureBoxesId);
+    if (index_ == pack_index::hilbert_rtree) {
+      packer_.register_segment(kHilbertRTreeIndexId);
+    }
   }
 
   virtual ~quadtree_feature_packer() = default;
@@ -53,6 +60,7 @@ struct quadtree_feature_packer {
 
   geo::tile root_;
   shared_metadata_coder const& metadata_coder_;
+  pack_index index_;
 
   feature_packer packer_;
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "geo/tile.h"
+
+#include "tiles/db/tile_database.h"
+
+namespace tiles {
+
+struct feature;
+struct pack_handle;
+
+// low zoom levels: one pack per tile with generalized geometry (simplified,
+// clipped, lines merged, polygons unioned, points thinned) -> rendering these
+// tiles does not touch the full resolution features anymore
+constexpr uint32_t kPyramidMaxZoomLvl = 8;
+
+// all features (deserialized for tile.z_) -> content of the pyramid pack
+std::vector<feature> generalize_features(std::vector<feature>,
+                                         geo::tile const&);
+
+void build_feature_pyramid(tile_db_handle&, pack_handle&,
+                           uint32_t max_zoomlevel = kPyramidMaxZoomLvl);
+
+// pyramid packs live in the pack file -> invalid after every repack
+inline void clear_feature_pyramid(tile_db_handle& db_handle, lmdb::txn& txn) {
+  txn.dbi_clear(db_handle.pyramid_dbi(txn));
+  txn.put(db_handle.meta_dbi(txn), kMetaKeyPyramidMaxZoomLevel,
+          std::to_string(-1));
+}
+
+}  // namespace tiles
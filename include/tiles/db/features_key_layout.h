@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utl/verify.h"
+
+#include "tiles/db/tile_database.h"
+#include "tiles/db/tile_index.h"
+#include "tiles/util.h"
+
+namespace tiles {
+
+// written by pack_features; databases without the flag are row major
+constexpr auto const kDefaultFeaturesKeyLayout = tile_key_layout::morton;
+
+constexpr auto kFeaturesKeyLayoutRowMajor = "row-major";
+constexpr auto kFeaturesKeyLayoutMorton = "morton";
+
+inline char const* to_str(tile_key_layout const layout) {
+  return layout == tile_key_layout::morton ? kFeaturesKeyLayoutMorton
+                                           : kFeaturesKeyLayoutRowMajor;
+}
+
+inline tile_key_layout get_features_key_layout(tile_db_handle& handle,
+                                               lmdb::txn& txn) {
+  auto meta_dbi = handle.meta_dbi(txn);
+  auto const opt_layout = txn.get(meta_dbi, kMetaKeyFeaturesKeyLayout);
+  if (!opt_layout || *opt_layout == kFeaturesKeyLayoutRowMajor) {
+    return tile_key_layout::row_major;
+  }
+  utl::verify(*opt_layout == kFeaturesKeyLayoutMorton,
+              "unknown features key layout: {}", *opt_layout);
+  return tile_key_layout::morton;
+}
+
+inline void set_features_key_layout(tile_db_handle& handle, lmdb::txn& txn,
+                                    tile_key_layout const layout) {
+  auto meta_dbi = handle.meta_dbi(txn);
+  txn.put(meta_dbi, kMetaKeyFeaturesKeyLayout, to_str(layout));
+}
+
+// rewrites all keys of the features dbi (pack records stay untouched)
+inline void migrate_features_key_layout(
+    tile_db_handle& handle, tile_key_layout const target_layout) {
+  auto txn = handle.make_txn();
+  auto const source_layout = get_features_key_layout(handle, txn);
+  if (source_layout == target_layout) {
+    t_log("features key layout is already {}", to_str(target_layout));
+    return;
+  }
+
+  auto features_dbi = handle.features_dbi(txn);
+  std::vector<std::pair<tile_key_t, std::string>> entries;
+  {
+    lmdb::cursor c{txn, features_dbi};
+    for (auto el = c.get<tile_key_t>(lmdb::cursor_op::FIRST); el;
+         el = c.get<tile_key_t>(lmdb::cursor_op::NEXT)) {
+      auto const tile = key_to_tile(el->first, source_layout);
+      entries.emplace_back(tile_to_key(tile, target_layout),
+                           std::string{el->second});
+    }
+  }
+
+  txn.dbi_clear(features_dbi);
+  for (auto const& [key, value] : entries) {
+    txn.put(features_dbi, key, value);
+  }
+  set_features_key_layout(handle, txn, target_layout);
+  txn.commit();
+
+  t_log("migrated {} feature keys: {} -> {}", printable_num{entries.size()},
+        to_str(source_layout), to_str(target_layout));
+}
+
+}  // namespace tiles
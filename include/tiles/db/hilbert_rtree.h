@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tiles/bin_utils.h"
+#include "tiles/fixed/fixed_geometry.h"
+
+namespace tiles {
+
+// PACKED HILBERT R-TREE "WIRE FORMAT" SPECIFICATION v1
+//
+// A static (bulk loaded) R-tree: all entries are sorted by the hilbert value
+// of their bounding box center and grouped into nodes of kHilbertRTreeNodeSize
+// items. These nodes are grouped again, until only the root item is left.
+// Unlike the quad tree, every node has the real bounding box of its subtree.
+//
+// Stored as alternative index in an extra segment of a feature pack. (See
+// feature_pack.h and feature_pack_quadtree.h for details.)
+//
+//  4b : uint32_t : entry count n
+//  followed by all items level by level (leaves first, root last), each item
+//  consists of six uint32_t values:
+//  - i[0-3] : min x, min y, max x, max y (z20 fixed coordinates, clamped)
+//  - i[4]   : min zoom level (bits 0-7) and max zoom level (bits 8-15)
+//             others: lowest min and highest max zoom level of the subtree
+//  - i[5]   : leaves: payload (e.g. feature offset in the pack)
+//             others: index of the first child item, children are the next
+//                     kHilbertRTreeNodeSize items (at most up to level end)
+//
+// The level sizes follow from n: n, ceil(n / node size), ..., 1
+
+constexpr uint32_t kHilbertRTreeNodeSize = 16;
+constexpr size_t kHilbertRTreeItemSize = 6;
+
+struct hilbert_rtree_input {
+  fixed_box box_;
+  uint32_t payload_;
+  std::pair<uint32_t, uint32_t> zoom_levels_{0U, 0xFFU};
+};
+
+std::string make_hilbert_rtree(std::vector<hilbert_rtree_input> input);
+
+inline uint32_t hilbert_rtree_coord(fixed_coord_t const c) {
+  return static_cast<uint32_t>(std::clamp(c, kFixedCoordMin, kFixedCoordMax));
+}
+
+// entries which intersect query and exist on zoom level z
+template <typename Fn>
+void walk_hilbert_rtree(char const* base, fixed_box const& query,
+                        uint32_t const z, Fn&& fn) {
+  auto const n = read_nth<uint32_t>(base, 0);
+  if (n == 0) {
+    return;  // whole tree empty
+  }
+
+  std::vector<uint32_t> level_ends{n};
+  for (auto size = n; size > 1;) {
+    size = (size + kHilbertRTreeNodeSize - 1) / kHilbertRTreeNodeSize;
+    level_ends.push_back(level_ends.back() + size);
+  }
+
+  auto const min_x = hilbert_rtree_coord(query.min_corner().x());
+  auto const min_y = hilbert_rtree_coord(query.min_corner().y());
+  auto const max_x = hilbert_rtree_coord(query.max_corner().x());
+  auto const max_y = hilbert_rtree_coord(query.max_corner().y());
+  auto const item = [&](uint32_t const i, size_t const k) {
+    return read_nth<uint32_t>(base, 1 + i * kHilbertRTreeItemSize + k);
+  };
+
+  // (item, level)
+  std::vector<std::pair<uint32_t, size_t>> stack{
+      {level_ends.back() - 1, level_ends.size() - 1}};
+  while (!stack.empty()) {
+    auto const [i, level] = stack.back();
+    stack.pop_back();
+
+    if (item(i, 0) > max_x || item(i, 1) > max_y || item(i, 2) < min_x ||
+        item(i, 3) < min_y) {
+      continue;
+    }
+
+    auto const zoom_levels = item(i, 4);
+    if ((zoom_levels & 0xFFU) > z || ((zoom_levels >> 8) & 0xFFU) < z) {
+      continue;
+    }
+
+    auto const ref = item(i, 5);
+    if (level == 0) {
+      fn(ref);
+      continue;
+    }
+
+    auto const end =
+        std::min(ref + kHilbertRTreeNodeSize, level_ends[level - 1]);
+    for (auto child = ref; child < end; ++child) {
+      stack.emplace_back(child, level - 1);
+    }
+  }
+}
+
+}  // namespace tiles
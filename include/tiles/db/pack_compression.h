@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tiles {
+
+struct tile_db_handle;
+struct pack_handle;
+
+// COMPRESSED FEATURE PACK
+//
+// A compressed pack is a valid feature pack (see feature_pack.h) without
+// features and with one kCompressedPackId segment, which points to:
+//
+//  1b : uint8_t  : codec (pack_codec)
+//  4b : uint32_t : size of the uncompressed pack
+//  ...           : zlib stream of the uncompressed pack
+//
+// Packs which do not get smaller are stored uncompressed.
+
+enum class pack_codec : uint8_t { none = 0, deflate = 1, deflate_dict = 2 };
+
+char const* to_str(pack_codec);
+pack_codec parse_pack_codec(std::string_view);
+
+// codec: deflate_dict if a dictionary is given, deflate otherwise
+std::string compress_pack(std::string const& pack,
+                          std::string const& dictionary = {});
+
+// uncompressed packs: the input, compressed packs: inflated into buf
+std::string_view decompress_pack(std::string_view pack, std::string& buf,
+                                 std::string const& dictionary = {});
+
+// zlib preset dictionary (max. 32kb) from the most frequent substrings
+std::string train_pack_dictionary(std::vector<std::string> const& samples);
+
+// dictionary of the database (if any) -> pack_handle
+void load_pack_dictionary(tile_db_handle&, pack_handle&);
+
+}  // namespace tiles
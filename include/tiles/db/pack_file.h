@@ -1,11 +1,16 @@
 #pragma once
 
 #include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "osmium/index/detail/mmap_vector_file.hpp"
+#include "protozero/varint.hpp"
 
 #include "tiles/bin_utils.h"
+#include "tiles/db/pack_compression.h"
 
 #include "utl/verify.h"
 
@@ -28,48 +33,106 @@ struct pack_record {
   size_t offset_, size_;
 };
 
+// PACK RECORDS ENCODING (values of the features / pyramid dbi)
+//
+// compact (version 1, written by pack_records_serialize):
+//  per record : varint : zigzag delta of the offset to the previous end offset
+//               varint : size
+//  1b         : uint8_t : version tag kPackRecordsCompact
+//
+// legacy (read only): raw pack_record structs (2x size_t each). The last byte
+// is the most significant byte of a size, so it is always zero there.
+//
+// An empty list is an empty string in both encodings.
+
+constexpr uint8_t kPackRecordsCompact = 1;
+
+inline void pack_records_append(std::string& buf, size_t& prev_end,
+                                pack_record const record) {
+  protozero::write_varint(
+      std::back_inserter(buf),
+      protozero::encode_zigzag64(static_cast<int64_t>(record.offset_) -
+                                 static_cast<int64_t>(prev_end)));
+  protozero::write_varint(std::back_inserter(buf), record.size_);
+  prev_end = record.end_offset();
+}
+
 inline std::string pack_records_serialize(pack_record record) {
   std::string buf;
-  append(buf, record);
+  size_t prev_end = 0;
+  pack_records_append(buf, prev_end, record);
+  append<uint8_t>(buf, kPackRecordsCompact);
   return buf;
 }
 
 inline std::string pack_records_serialize(
     std::vector<pack_record> const& records) {
   std::string buf;
-  buf.reserve(records.size() * sizeof(pack_record));
+  if (records.empty()) {
+    return buf;
+  }
+
+  size_t prev_end = 0;
   for (auto const& record : records) {
-    append(buf, record);
+    pack_records_append(buf, prev_end, record);
   }
+  append<uint8_t>(buf, kPackRecordsCompact);
   return buf;
 }
 
-inline void pack_records_update(std::string& dat, pack_record record) {
-  utl::verify(dat.size() % sizeof(pack_record) == 0,
-              "pack_records_update: invalid pack_record count");
-  append(dat, record);
+inline bool pack_records_compact(std::string_view const dat) {
+  return !dat.empty() &&
+         static_cast<uint8_t>(dat.back()) == kPackRecordsCompact;
 }
 
-inline std::vector<pack_record> pack_records_deserialize(std::string_view dat) {
-  utl::verify(dat.size() % sizeof(pack_record) == 0,
-              "pack_records_deserialize: invalid pack_record count");
-  auto const size = dat.size() / sizeof(pack_record);
+template <typename Fn>
+inline void pack_records_foreach(std::string_view dat, Fn&& fn) {
+  if (!pack_records_compact(dat)) {
+    utl::verify(dat.size() % sizeof(pack_record) == 0,
+                "pack_records_foreach: invalid pack_record count");
+    for (size_t i = 0; i < dat.size() / sizeof(pack_record); ++i) {
+      fn(read_nth<pack_record>(dat.data(), i));
+    }
+    return;
+  }
 
-  std::vector<pack_record> vec;
-  vec.reserve(size);
-  for (size_t i = 0; i < size; ++i) {
-    vec.push_back(read_nth<pack_record>(dat.data(), i));
+  auto ptr = dat.data();
+  auto const end = dat.data() + dat.size() - 1;  // without version tag
+  size_t prev_end = 0;
+  while (ptr != end) {
+    auto const offset = static_cast<int64_t>(prev_end) +
+                        protozero::decode_zigzag64(
+                            protozero::decode_varint(&ptr, end));
+    utl::verify(offset >= 0, "pack_records_foreach: invalid offset");
+    pack_record const record{static_cast<size_t>(offset),
+                             protozero::decode_varint(&ptr, end)};
+    prev_end = record.end_offset();
+    fn(record);
   }
-  return vec;
 }
 
-template <typename Fn>
-inline void pack_records_foreach(std::string_view dat, Fn&& fn) {
-  utl::verify(dat.size() % sizeof(pack_record) == 0,
-              "pack_records_foreach: invalid pack_record count");
-  for (size_t i = 0; i < dat.size() / sizeof(pack_record); ++i) {
-    fn(read_nth<pack_record>(dat.data(), i));
+inline void pack_records_update(std::string& dat, pack_record record) {
+  if (!pack_records_compact(dat)) {  // empty or legacy -> rewrite
+    utl::verify(dat.size() % sizeof(pack_record) == 0,
+                "pack_records_update: invalid pack_record count");
+    std::vector<pack_record> records;
+    pack_records_foreach(dat, [&](auto const& r) { records.push_back(r); });
+    records.push_back(record);
+    dat = pack_records_serialize(records);
+    return;
   }
+
+  size_t prev_end = 0;
+  pack_records_foreach(dat, [&](auto const& r) { prev_end = r.end_offset(); });
+  dat.pop_back();  // version tag
+  pack_records_append(dat, prev_end, record);
+  append<uint8_t>(dat, kPackRecordsCompact);
+}
+
+inline std::vector<pack_record> pack_records_deserialize(std::string_view dat) {
+  std::vector<pack_record> vec;
+  pack_records_foreach(dat, [&](auto const& r) { vec.push_back(r); });
+  return vec;
 }
 
 inline std::string pack_file_name(char const* db_fname) {
@@ -93,6 +156,24 @@ inline void clear_pack_file(char const* db_fname) {
   utl::verify(std::fclose(f) == 0, "clear_pack_file: problem while fclose");
 }
 
+// view into the pack file or (compressed packs) into the owned inflated copy
+// -> valid as long as this object (not movable: the view may point into buf_)
+struct pack_data {
+  pack_data(std::string_view const pack, std::string const& dictionary)
+      : view_{decompress_pack(pack, buf_, dictionary)} {}
+
+  pack_data(pack_data const&) = delete;
+  pack_data(pack_data&&) = delete;
+  pack_data& operator=(pack_data const&) = delete;
+  pack_data& operator=(pack_data&&) = delete;
+
+  std::string_view view() const { return view_; }
+  explicit operator std::string_view() const { return view_; }
+
+  std::string buf_;
+  std::string_view view_;
+};
+
 struct pack_handle {
   explicit pack_handle(char const* db_fname) {
     auto const fname = pack_file_name(db_fname);
@@ -129,12 +210,14 @@ struct pack_handle {
 
   void resize(size_t new_size) { dat_.resize(new_size); }
 
-  std::string_view get(pack_record record) const {
+  pack_data get(pack_record record) const {
     utl::verify(record.offset_ < dat_.size() &&
                     record.offset_ + record.size_ <= dat_.size(),
                 "pack_file: record not file [size={},record=({},{})",
                 dat_.size(), record.offset_, record.size_);
-    return std::string_view{dat_.data() + record.offset_, record.size_};
+    return pack_data{
+        std::string_view{dat_.data() + record.offset_, record.size_},
+        dictionary_};
   }
 
   pack_record move(size_t offset, pack_record from_record) {
@@ -156,6 +239,8 @@ struct pack_handle {
 
   FILE* file_;
   osmium::detail::mmap_vector_file<char> dat_;
+
+  std::string dictionary_;  // see load_pack_dictionary
 };
 
 }  // namespace tiles
\ No newline at end of file
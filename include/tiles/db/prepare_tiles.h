@@ -1,12 +1,15 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 namespace tiles {
 
 struct tile_db_handle;
 struct pack_handle;
 
-void prepare_tiles(tile_db_handle&, pack_handle&, uint32_t max_zoomlevel);
+// tile_extents: mvt extent per zoom level (see render_ctx), stored in meta
+void prepare_tiles(tile_db_handle&, pack_handle&, uint32_t max_zoomlevel,
+                   std::vector<uint32_t> const& tile_extents = {});
 
 }  // namespace tiles
@@ -295,7 +295,7 @@ void repack_features(PackHandle& pack_handle,
     auto const enqueue = [&] {
       auto task = mgr.dequeue_task();
       auto packs = utl::to_vec(task.records_, [&](auto const& r) {
-        return Buf{pack_handle.get(r)};
+        return Buf{std::string_view{pack_handle.get(r)}};
       });
       work_queue.enqueue([&, tile = task.tile_, packs = std::move(packs)] {
         result_queue.enqueue({tile, pack_features(tile, packs)});
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "protozero/pbf_reader.hpp"
@@ -107,11 +109,25 @@ struct shared_metadata_decoder {
   shared_metadata_decoder() = default;
 
   explicit shared_metadata_decoder(std::vector<metadata> data)
-      : dec_data_{std::move(data)} {}
+      : dec_data_{std::move(data)} {
+    std::unordered_map<std::string_view, uint32_t> keys, values;
+    key_ids_.reserve(dec_data_.size());
+    value_ids_.reserve(dec_data_.size());
+    for (auto const& m : dec_data_) {
+      key_ids_.push_back(keys.emplace(m.key_, keys.size()).first->second);
+      value_ids_.push_back(
+          values.emplace(m.value_, values.size()).first->second);
+    }
+    key_count_ = keys.size();
+  }
 
   metadata const& decode(uint64_t id) const { return dec_data_.at(id); }
 
   std::vector<metadata> dec_data_;
+
+  // per id: dense index of the distinct key / value string
+  std::vector<uint32_t> key_ids_, value_ids_;
+  size_t key_count_{0};
 };
 
 struct shared_metadata_coder : public shared_metadata_decoder {
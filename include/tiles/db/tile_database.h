@@ -12,11 +12,19 @@ namespace tiles {
 constexpr auto kDefaultMeta = "default_meta";
 constexpr auto kDefaultFeatures = "default_features";
 constexpr auto kDefaultTiles = "default_tiles";
+constexpr auto kDefaultPyramid = "default_pyramid";
 
 constexpr auto kMetaKeyMaxPreparedZoomLevel = "max-prepared-zoomlevel";
+constexpr auto kMetaKeyPreparedTileFraming = "prepared-tile-framing";
+constexpr auto kPreparedTileFraming = "zlib+gzip-trailer";
 constexpr auto kMetaKeyFullySeasideTree = "fully-seaside-tree";
 constexpr auto kMetaKeyLayerNames = "layer-names";
 constexpr auto kMetaKeyFeatureMetaCoding = "feature-meta-coding";
+constexpr auto kMetaKeyFeaturesKeyLayout = "features-key-layout";
+constexpr auto kMetaKeyPyramidMaxZoomLevel = "pyramid-max-zoomlevel";
+constexpr auto kMetaKeyPackCodec = "pack-codec";
+constexpr auto kMetaKeyPackDictionary = "pack-dictionary";
+constexpr auto kMetaKeyTileExtents = "tile-extents";
 
 using dbi_opener_fn =
     std::function<lmdb::txn::dbi(lmdb::txn&, lmdb::dbi_flags)>;
@@ -40,15 +48,18 @@ struct tile_db_handle {
   explicit tile_db_handle(lmdb::env& env,
                           char const* dbi_name_meta = kDefaultMeta,
                           char const* dbi_name_features = kDefaultFeatures,
-                          char const* dbi_name_tiles = kDefaultTiles)
+                          char const* dbi_name_tiles = kDefaultTiles,
+                          char const* dbi_name_pyramid = kDefaultPyramid)
       : env_{env},
         dbi_name_meta_{dbi_name_meta},
         dbi_name_features_{dbi_name_features},
-        dbi_name_tiles_{dbi_name_tiles} {
+        dbi_name_tiles_{dbi_name_tiles},
+        dbi_name_pyramid_{dbi_name_pyramid} {
     auto txn = make_txn();
     meta_dbi(txn, lmdb::dbi_flags::CREATE);
     features_dbi(txn, lmdb::dbi_flags::CREATE);
     tiles_dbi(txn, lmdb::dbi_flags::CREATE);
+    pyramid_dbi(txn, lmdb::dbi_flags::CREATE);
     txn.commit();
   }
 
@@ -80,6 +91,12 @@ struct tile_db_handle {
     return txn.dbi_open(dbi_name_tiles_, flags | lmdb::dbi_flags::INTEGERKEY);
   }
 
+  lmdb::txn::dbi pyramid_dbi(lmdb::txn& txn,
+                             lmdb::dbi_flags flags = lmdb::dbi_flags::NONE) {
+    return txn.dbi_open(dbi_name_pyramid_,
+                        flags | lmdb::dbi_flags::INTEGERKEY);
+  }
+
   dbi_opener_fn meta_dbi_opener() {
     using namespace std::placeholders;
     return std::bind(&tile_db_handle::meta_dbi, this, _1, _2);
@@ -99,6 +116,7 @@ struct tile_db_handle {
   char const* dbi_name_meta_;
   char const* dbi_name_features_;
   char const* dbi_name_tiles_;
+  char const* dbi_name_pyramid_;
 };
 
 struct dbi_handle {
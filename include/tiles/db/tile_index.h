@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "geo/tile.h"
 
 #include "utl/verify.h"
@@ -59,7 +61,99 @@ inline tile_key_t key_to_n(tile_key_t const key) {
   return (key >> kTileKeyNShift) & kTileKeyNMask;
 }
 
+// features dbi key layout (see kMetaKeyFeaturesKeyLayout)
+// - row_major: as tile_to_key -> one key range per row of index tiles
+// - morton: z | interleaved y/x (z-order) | n -> one key range per tile
+//   of the quadtree (all index tiles below a query tile are contiguous)
+enum class tile_key_layout : uint8_t { row_major, morton };
+
+constexpr tile_key_t kTileKeyMortonShift{17ULL};
+constexpr tile_key_t kTileKeyMortonBits{42ULL};
+
+inline tile_key_t morton_spread(tile_key_t v) {
+  v &= 0x00000000FFFFFFFFULL;
+  v = (v | (v << 16ULL)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v << 8ULL)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v << 4ULL)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v << 2ULL)) & 0x3333333333333333ULL;
+  v = (v | (v << 1ULL)) & 0x5555555555555555ULL;
+  return v;
+}
+
+inline tile_key_t morton_compact(tile_key_t v) {
+  v &= 0x5555555555555555ULL;
+  v = (v ^ (v >> 1ULL)) & 0x3333333333333333ULL;
+  v = (v ^ (v >> 2ULL)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v ^ (v >> 4ULL)) & 0x00FF00FF00FF00FFULL;
+  v = (v ^ (v >> 8ULL)) & 0x0000FFFF0000FFFFULL;
+  v = (v ^ (v >> 16ULL)) & 0x00000000FFFFFFFFULL;
+  return v;
+}
+
+inline tile_key_t tile_to_key(geo::tile const t, tile_key_layout const layout,
+                              tile_key_t const n = 0) {
+  if (layout == tile_key_layout::row_major) {
+    return tile_to_key(t, n);
+  }
+
+  utl::verify((t.x_ & kTileKeyXMask) == t.x_ &&
+                  (t.y_ & kTileKeyYMask) == t.y_ &&
+                  (t.z_ & kTileKeyZMask) == t.z_ && (n & kTileKeyNMask) == n,
+              "tile_to_key: value(s) in invalid range(s)");
+
+  tile_key_t key{0};
+  key |= (t.z_ & kTileKeyZMask) << kTileKeyZShift;
+  key |= (morton_spread(t.x_) | (morton_spread(t.y_) << 1ULL))
+         << kTileKeyMortonShift;
+  key |= (n & kTileKeyNMask) << kTileKeyNShift;
+  return key;
+}
+
+inline geo::tile key_to_tile(tile_key_t const key,
+                             tile_key_layout const layout) {
+  if (layout == tile_key_layout::row_major) {
+    return key_to_tile(key);
+  }
+
+  auto const m = (key >> kTileKeyMortonShift) &
+                 ((1ULL << kTileKeyMortonBits) - 1ULL);
+  return geo::tile{
+      static_cast<uint32_t>(morton_compact(m)),
+      static_cast<uint32_t>(morton_compact(m >> 1ULL)),
+      static_cast<uint32_t>((key >> kTileKeyZShift) & kTileKeyZMask)};
+}
+
+// morton layout: [begin, end) of the keys of all tiles on level z which
+// are inside the query tile (or its parent on level z if q is deeper)
+inline std::pair<tile_key_t, tile_key_t> morton_key_range(geo::tile const& q,
+                                                          uint32_t const z) {
+  utl::verify(z < kTileKeyZMask, "morton_key_range: invalid z");
+  auto const first =
+      q.z_ <= z ? geo::tile{q.x_ << (z - q.z_), q.y_ << (z - q.z_), z}
+                : geo::tile{q.x_ >> (q.z_ - z), q.y_ >> (q.z_ - z), z};
+  auto const count = q.z_ <= z ? 1ULL << (2 * (z - q.z_)) : 1ULL;
+
+  auto const begin = tile_to_key(first, tile_key_layout::morton);
+  return {begin, begin + (count << kTileKeyMortonShift)};
+}
+
 constexpr auto const kTileDefaultIndexZoomLvl = 10;
+
+// features are bucketed on the deepest of these levels which is <= their min
+// zoom level: low zoom renders do not scan the detailed z10 buckets
+constexpr std::array<uint32_t, 3> kTileIndexZoomLvls{
+    {4, 7, kTileDefaultIndexZoomLvl}};
+
+inline uint32_t index_zoom_level(uint32_t const min_zoom_level) {
+  auto lvl = kTileIndexZoomLvls.front();
+  for (auto const z : kTileIndexZoomLvls) {
+    if (z <= min_zoom_level) {
+      lvl = z;
+    }
+  }
+  return lvl;
+}
+
 inline geo::tile_range make_tile_range(fixed_box /*copy*/ box,
                                        uint32_t z = kTileDefaultIndexZoomLvl) {
   shift(box, z);
@@ -72,4 +166,32 @@ inline geo::tile_range make_tile_range(fixed_box /*copy*/ box,
   return geo::make_tile_range(x_1, y_1, x_2, y_2, z);
 }
 
+// number of index tiles on z touched by the box
+inline uint64_t index_tile_count(fixed_box /*copy*/ box, uint32_t const z) {
+  shift(box, z);
+
+  uint64_t const dx = box.max_corner().x() / kTileSize -  //
+                      box.min_corner().x() / kTileSize;
+  uint64_t const dy = box.max_corner().y() / kTileSize -  //
+                      box.min_corner().y() / kTileSize;
+  return (dx + 1) * (dy + 1);
+}
+
+// large features (long rivers, borders, landuse) would be copied into every
+// index tile they touch -> use a coarser level until only a few are touched
+constexpr uint64_t kTileIndexMaxFeatureCopies = 16;
+
+inline uint32_t index_zoom_level(fixed_box const& box,
+                                 uint32_t const min_zoom_level) {
+  auto const max_z = index_zoom_level(min_zoom_level);
+  for (auto it = kTileIndexZoomLvls.rbegin(); it != kTileIndexZoomLvls.rend();
+       ++it) {
+    if (*it <= max_z &&
+        index_tile_count(box, *it) <= kTileIndexMaxFeatureCopies) {
+      return *it;
+    }
+  }
+  return kTileIndexZoomLvls.front();
+}
+
 }  // namespace tiles
@@ -1,13 +1,22 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace tiles {
 
 struct feature;
 
-std::vector<feature> aggregate_polygon_features(std::vector<feature>,
-                                                uint32_t z);
+template <typename T>
+struct queue_wrapper;
+
+// polygons are merged (union) only on lower zoom levels
+constexpr uint32_t kAggregatePolygonMaxZoomLevel = 10;
+
+// groups with equal metadata: union + simplification (in parallel if queue)
+std::vector<feature> aggregate_polygon_features(
+    std::vector<feature>, uint32_t z,
+    queue_wrapper<std::function<void()>>* queue = nullptr);
 
 }  // namespace tiles
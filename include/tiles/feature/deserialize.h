@@ -4,7 +4,9 @@
 
 #include "protozero/pbf_message.hpp"
 
+#include "tiles/db/layer_names.h"
 #include "tiles/db/shared_metadata.h"
+#include "tiles/db/tile_index.h"
 #include "tiles/feature/feature.h"
 #include "tiles/fixed/algo/delta.h"
 #include "tiles/fixed/io/deserialize.h"
@@ -12,12 +14,22 @@
 
 namespace tiles {
 
+// features are stored in every index tile (see index_zoom_level) their
+// bounding box touches -> only use the copy from the first queried index tile
+struct home_bucket_hint {
+  fixed_xy query_min_;  // min corner of the queried area (z20)
+  geo::tile bucket_;  // index tile the feature is read from
+};
+
 inline std::optional<feature> deserialize_feature(
     std::string_view const& str,  //
     shared_metadata_decoder const& metadata_decoder,
     fixed_box const& box_hint = {{kInvalidBoxHint, kInvalidBoxHint},
                                  {kInvalidBoxHint, kInvalidBoxHint}},
-    uint32_t const zoom_level_hint = kInvalidZoomLevel) {
+    uint32_t const zoom_level_hint = kInvalidZoomLevel,
+    bool const defer_geometry = false,
+    std::optional<home_bucket_hint> const& home_hint = std::nullopt,
+    bool const drop_subpixel_polygons = false) {
 
   uint64_t id = 0;
   std::pair<uint32_t, uint32_t> zoom_levels{kInvalidZoomLevel,
@@ -28,9 +40,16 @@ inline std::optional<feature> deserialize_feature(
 
   size_t meta_fill = 0;
   std::vector<metadata> meta;
+  std::vector<uint64_t> shared_meta_ids;
 
   std::vector<std::string_view> simplify_masks;
   fixed_geometry geometry;
+  fixed_box bbox{{kInvalidBoxHint, kInvalidBoxHint},
+                 {kInvalidBoxHint, kInvalidBoxHint}};
+
+  // geometry is strictly inside the box hint -> may skip clipping
+  bool inside_box_hint = false;
+  std::string_view serialized_geometry;
 
   namespace pz = protozero;
   pz::pbf_message<tags::feature> msg{str.data(), str.size()};
@@ -63,6 +82,10 @@ inline std::optional<feature> deserialize_feature(
              min_x > box_hint.max_corner().x())) {
           return std::nullopt;
         }
+        inside_box_hint = box_hint.min_corner().x() != kInvalidBoxHint &&
+                          box_hint.max_corner().x() != kInvalidBoxHint &&
+                          min_x > box_hint.min_corner().x() &&
+                          max_x < box_hint.max_corner().x();
 
         delta_decoder y_dec{kFixedCoordMagicOffset};
         auto const min_y = y_dec.decode(static_cast<fixed_coord_t>(next()));
@@ -73,8 +96,34 @@ inline std::optional<feature> deserialize_feature(
              min_y > box_hint.max_corner().y())) {
           return std::nullopt;
         }
+        inside_box_hint = inside_box_hint &&
+                          box_hint.min_corner().y() != kInvalidBoxHint &&
+                          box_hint.max_corner().y() != kInvalidBoxHint &&
+                          min_y > box_hint.min_corner().y() &&
+                          max_y < box_hint.max_corner().y();
+
+        bbox = fixed_box{{min_x, min_y}, {max_x, max_y}};
+
+        if (home_hint) {
+          fixed_xy const home{std::max(min_x, home_hint->query_min_.x()),
+                              std::max(min_y, home_hint->query_min_.y())};
+          auto const home_range =
+              make_tile_range(fixed_box{home, home}, home_hint->bucket_.z_);
+          if (*home_range.begin() != home_hint->bucket_) {
+            return std::nullopt;  // copy from another index tile
+          }
+        }
 
         layer = static_cast<size_t>(next());  // layer key
+
+        // optional: missing in databases created before area classes
+        auto const area_class =
+            range.empty() ? kNoAreaClass : static_cast<uint32_t>(next());
+        if (drop_subpixel_polygons && zoom_level_hint != kInvalidZoomLevel &&
+            layer != kLayerCoastlineIdx &&
+            is_subpixel_area(area_class, zoom_level_hint)) {
+          return std::nullopt;
+        }
         utl::verify(range.empty(), "read_header: superfluous elements");
       } break;
 
@@ -85,6 +134,7 @@ inline std::optional<feature> deserialize_feature(
                     "meta_pairs must come before, meta keys/values!");
         for (auto const id : msg.get_packed_uint64()) {
           meta.push_back(metadata_decoder.decode(id));
+          shared_meta_ids.push_back(id);
         }
         meta_fill = meta.size();
         break;
@@ -100,6 +150,12 @@ inline std::optional<feature> deserialize_feature(
         simplify_masks.emplace_back(msg.get_view());
         break;
       case tags::feature::required_fixed_geometry_geometry: {
+        if (defer_geometry && inside_box_hint &&
+            zoom_level_hint != kInvalidZoomLevel) {
+          serialized_geometry = msg.get_view();
+          geometry = deserialize_empty(serialized_geometry);
+          break;
+        }
 
         std::vector<std::string_view> simplify_masks_tmp;
         std::swap(simplify_masks, simplify_masks_tmp);
@@ -121,7 +177,15 @@ inline std::optional<feature> deserialize_feature(
   utl::verify(meta_fill == meta.size(), "meta data imbalance! (b)");
   utl::verify(layer != kInvalidLayer, "invalid layer found!");
 
-  return feature{id, layer, zoom_levels, std::move(meta), std::move(geometry)};
+  return feature{id,
+                 layer,
+                 zoom_levels,
+                 std::move(meta),
+                 std::move(geometry),
+                 serialized_geometry,
+                 std::move(simplify_masks),
+                 std::move(shared_meta_ids),
+                 bbox};
 }
 
 }  // namespace tiles
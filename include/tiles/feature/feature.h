@@ -2,6 +2,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include "protozero/types.hpp"
@@ -18,12 +19,33 @@ constexpr uint32_t kInvalidZoomLevel = 0x3F;  // 63; max for one byte in svarint
 constexpr fixed_coord_t kInvalidBoxHint =
     std::numeric_limits<fixed_coord_t>::max();
 
+// feature header: polygons store an area class c with area < 2^(c - 1)
+constexpr uint32_t kNoAreaClass = 0;  // no polygon (or old database)
+
+// one tile unit at zoom level z is 2^(20 - z) fixed coordinate units
+inline bool is_subpixel_area(uint32_t const area_class, uint32_t const z) {
+  return area_class != kNoAreaClass &&
+         area_class - 1 <= kScreenPixelAreaLog2 + 2 * (20 - z);
+}
+
 struct feature {
   uint64_t id_{kInvalidFeatureId};
   size_t layer_{kInvalidLayerId};
   std::pair<uint32_t, uint32_t> zoom_levels_;
   std::vector<metadata> meta_;
   fixed_geometry geometry_;
+
+  // set if the geometry was not deserialized (geometry_ is empty but has the
+  // correct type) -> view into the feature pack, see transcode_geometry
+  std::string_view serialized_geometry_{};
+  std::vector<std::string_view> simplify_masks_{};
+
+  // ids (see shared_metadata_decoder) of the leading entries in meta_
+  std::vector<uint64_t> shared_meta_ids_{};
+
+  // bounding box from the stored header (invalid if unknown)
+  fixed_box bbox_{{kInvalidBoxHint, kInvalidBoxHint},
+                  {kInvalidBoxHint, kInvalidBoxHint}};
 };
 
 namespace tags {
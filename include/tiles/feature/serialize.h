@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cmath>
 
 #include "protozero/pbf_builder.hpp"
 
@@ -13,6 +14,32 @@
 
 namespace tiles {
 
+inline uint32_t area_class(fixed_geometry const& geometry) {
+  auto const* polygon = mpark::get_if<fixed_polygon>(&geometry);
+  if (polygon == nullptr) {
+    return kNoAreaClass;
+  }
+
+  // in double: the area of huge polygons does not fit into fixed_coord_t
+  auto const ring_area = [](fixed_ring const& ring) {
+    auto sum = 0.;
+    for (auto i = 1ULL; i < ring.size(); ++i) {
+      sum += static_cast<double>(ring[i - 1].x()) * ring[i].y() -
+             static_cast<double>(ring[i].x()) * ring[i - 1].y();
+    }
+    return std::abs(sum) / 2.;
+  };
+
+  auto area = 0.;
+  for (auto const& p : *polygon) {
+    area += ring_area(p.outer());
+    for (auto const& inner : p.inners()) {
+      area -= ring_area(inner);
+    }
+  }
+  return area < 1. ? 1U : static_cast<uint32_t>(std::log2(area)) + 2U;
+}
+
 inline std::string serialize_feature(
     feature const& f, shared_metadata_coder const& metadata_coder = {},
     bool fast = true) {
@@ -25,14 +52,15 @@ inline std::string serialize_feature(
   delta_encoder x_enc{kFixedCoordMagicOffset};
   delta_encoder y_enc{kFixedCoordMagicOffset};
 
-  std::array<int64_t, 7> header{{
+  std::array<int64_t, 8> header{{
       f.zoom_levels_.first,  // 0: min zoom level
       f.zoom_levels_.second,  // 1:  max zoom level
       x_enc.encode(box.min_corner().x()),  // 2
       x_enc.encode(box.max_corner().x()),  // 3
       y_enc.encode(box.min_corner().y()),  // 4
       y_enc.encode(box.max_corner().y()),  // 5
-      static_cast<int64_t>(f.layer_)  // 6
+      static_cast<int64_t>(f.layer_),  // 6
+      area_class(f.geometry_)  // 7
   }};
 
   pb.add_packed_sint64(tags::feature::packed_sint64_header,  //
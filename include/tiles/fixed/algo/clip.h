@@ -6,4 +6,19 @@ namespace tiles {
 
 fixed_geometry clip(fixed_geometry const&, fixed_box const&);
 
+// union of all (corrected) polygons; vertices closer than tolerance to
+// their neighbors are removed beforehand
+fixed_geometry union_polygons(fixed_polygon const&, fixed_coord_t tolerance);
+
+// rectilinear union of (possibly overlapping) boxes, collinear vertices of
+// merged edges are removed
+fixed_geometry union_boxes(std::vector<fixed_box> const&);
+
+// true if no ring of the polygon touches the box and the box lies inside
+// -> clip(polygon, box) would yield exactly the box
+bool covers(fixed_polygon const&, fixed_box const&);
+
+// the box as (corrected) polygon
+fixed_polygon to_polygon(fixed_box const&);
+
 }  // namespace tiles
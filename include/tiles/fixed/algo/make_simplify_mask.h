@@ -1,9 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
 #include "utl/to_vec.h"
 
 #include "geo/simplify_mask.h"
 
+#include "tiles/constants.h"
+#include "tiles/fixed/algo/simplify.h"
+#include "tiles/fixed/fixed_geometry.h"
+
 namespace tiles {
 
 inline std::vector<std::string> make_simplify_mask(fixed_null const&) {
@@ -19,18 +26,37 @@ inline std::vector<std::string> make_simplify_mask(fixed_polyline const& geo) {
   });
 }
 
+// ring aware (see simplify_ring_areas): threshold is one screen pixel
+// (like is_subpixel_area), finer changes are invisible when rendered
+inline geo::simplify_mask_t make_ring_simplify_mask(
+    std::vector<double> const& areas) {
+  geo::simplify_mask_t mask;
+  for (auto z = 0ULL; z < mask.size(); ++z) {
+    auto const threshold = std::ldexp(
+        1., static_cast<int>(2 * (kMaxZoomLevel - z) + kScreenPixelAreaLog2));
+    mask[z] = utl::to_vec(areas, [&](auto const a) { return a >= threshold; });
+  }
+  return mask;
+}
+
 inline std::vector<std::string> make_simplify_mask(fixed_polygon const& geo) {
-  std::vector<std::string> masks;
-  for (auto const& polygon : geo) {
-    masks.emplace_back(
-        geo::serialize_simplify_mask(geo::make_simplify_mask(polygon.outer())));
-
-    for (auto const& inner : polygon.inners()) {
-      masks.emplace_back(
-          geo::serialize_simplify_mask(geo::make_simplify_mask(inner)));
-    }
+  auto const is_simple = [](auto const& polygon) {
+    return polygon.outer().size() < kSimplifyRingMinSize &&
+           std::all_of(begin(polygon.inners()), end(polygon.inners()),
+                       [](auto const& inner) {
+                         return inner.size() < kSimplifyRingMinSize;
+                       });
+  };
+  if (std::all_of(begin(geo), end(geo), is_simple)) {
+    return {};  // e.g. buildings: nothing to simplify -> no masks at all
   }
-  return masks;
+
+  // all rings at once: removed points must not create crossings between them
+  return utl::to_vec(simplify_ring_areas(polygon_rings(geo)),
+                     [](auto const& areas) {
+                       return geo::serialize_simplify_mask(
+                           make_ring_simplify_mask(areas));
+                     });
 }
 
 inline std::vector<std::string> make_simplify_mask(fixed_geometry const& geo) {
@@ -7,26 +7,37 @@
 
 namespace tiles {
 
-inline fixed_geometry shift(fixed_null, uint32_t const) { return fixed_null{}; }
+// fixed coordinates (z20) -> pixel coordinates on zoom level z (extent 4096)
+// extent_shift: additional quantization to a smaller extent (4096 >> shift)
+// consecutive duplicate vertices and degenerate lines/rings are removed
 
-inline void shift(fixed_xy& pt, uint32_t const z) {
-  uint32_t delta_z = 20 - z;
+inline fixed_geometry shift(fixed_null, uint32_t const,
+                            uint32_t const = 0) {
+  return fixed_null{};
+}
+
+inline void shift(fixed_xy& pt, uint32_t const z,
+                  uint32_t const extent_shift = 0) {
+  uint32_t delta_z = 20 - z + extent_shift;
   pt.x(pt.x() >> delta_z);
   pt.y(pt.y() >> delta_z);
 }
 
-inline void shift(fixed_box& box, uint32_t const z) {
-  shift(box.min_corner(), z);
-  shift(box.max_corner(), z);
+inline void shift(fixed_box& box, uint32_t const z,
+                  uint32_t const extent_shift = 0) {
+  shift(box.min_corner(), z, extent_shift);
+  shift(box.max_corner(), z, extent_shift);
 }
 
 template <typename Container>
-inline void shift_container(Container& c, uint32_t const z) {
-  transform_erase(c, [&](auto& e) { shift(e, z); });
+inline void shift_container(Container& c, uint32_t const z,
+                            uint32_t const extent_shift) {
+  transform_erase(c, [&](auto& e) { shift(e, z, extent_shift); });
 }
 
-inline fixed_geometry shift(fixed_point multi_point, uint32_t const z) {
-  shift_container(multi_point, z);
+inline fixed_geometry shift(fixed_point multi_point, uint32_t const z,
+                            uint32_t const extent_shift = 0) {
+  shift_container(multi_point, z, extent_shift);
   if (multi_point.empty()) {
     return fixed_null{};
   } else {
@@ -34,9 +45,10 @@ inline fixed_geometry shift(fixed_point multi_point, uint32_t const z) {
   }
 }
 
-inline fixed_geometry shift(fixed_polyline multi_polyline, uint32_t const z) {
+inline fixed_geometry shift(fixed_polyline multi_polyline, uint32_t const z,
+                            uint32_t const extent_shift = 0) {
   for (auto& polyline : multi_polyline) {
-    shift_container(polyline, z);
+    shift_container(polyline, z, extent_shift);
   }
 
   utl::erase_if(multi_polyline, [](auto const& p) { return p.size() < 2; });
@@ -48,18 +60,20 @@ inline fixed_geometry shift(fixed_polyline multi_polyline, uint32_t const z) {
   }
 }
 
-inline fixed_geometry shift(fixed_polygon multi_polygon, uint32_t const z) {
+inline fixed_geometry shift(fixed_polygon multi_polygon, uint32_t const z,
+                            uint32_t const extent_shift = 0) {
+  // closed rings: at least three distinct vertices
   for (auto& polygon : multi_polygon) {
-    shift_container(polygon.outer(), z);
+    shift_container(polygon.outer(), z, extent_shift);
     for (auto& ring : polygon.inners()) {
-      shift_container(ring, z);
+      shift_container(ring, z, extent_shift);
     }
 
-    utl::erase_if(polygon.inners(), [](auto const& r) { return r.size() < 3; });
+    utl::erase_if(polygon.inners(), [](auto const& r) { return r.size() < 4; });
   }
 
   utl::erase_if(multi_polygon,
-                [](auto const& p) { return p.outer().size() < 3; });
+                [](auto const& p) { return p.outer().size() < 4; });
 
   if (multi_polygon.empty()) {
     return fixed_null{};
@@ -68,9 +82,11 @@ inline fixed_geometry shift(fixed_polygon multi_polygon, uint32_t const z) {
   }
 }
 
-inline fixed_geometry shift(fixed_geometry geometry, uint32_t const z) {
-  return mpark::visit([&](auto arg) { return shift(std::move(arg), z); },
-                      std::move(geometry));
+inline fixed_geometry shift(fixed_geometry geometry, uint32_t const z,
+                            uint32_t const extent_shift = 0) {
+  return mpark::visit(
+      [&](auto arg) { return shift(std::move(arg), z, extent_shift); },
+      std::move(geometry));
 }
 
 }  // namespace tiles
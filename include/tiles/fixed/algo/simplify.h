@@ -1,5 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 #include "geo/simplify_mask.h"
 
 #include "tiles/fixed/fixed_geometry.h"
@@ -20,7 +29,225 @@ inline fixed_geometry simplify(fixed_polyline multi_polyline,
   return multi_polyline;
 }
 
-inline fixed_geometry simplify(fixed_polygon multi_polygon, uint32_t const) {
+// "simple" rings (e.g. rectangles) are never simplified
+constexpr auto const kSimplifyRingMinSize = 6;
+
+// uniform grid over the vertices of all rings of a polygon (vertices are only
+// removed, never moved) -> is any remaining vertex inside of a triangle?
+template <typename Ring>
+struct ring_vertex_grid {
+  explicit ring_vertex_grid(std::vector<Ring const*> const& rings)
+      : rings_{rings} {
+    auto n = 0ULL;
+    for (auto const* ring : rings_) {
+      removed_.emplace_back(ring->size(), false);
+      for (auto const& p : *ring) {
+        min_x_ = std::min(min_x_, p.x());
+        min_y_ = std::min(min_y_, p.y());
+        max_x_ = std::max(max_x_, p.x());
+        max_y_ = std::max(max_y_, p.y());
+        ++n;
+      }
+    }
+    if (n == 0) {
+      return;
+    }
+
+    cells_per_axis_ = std::max(
+        fixed_coord_t{1}, static_cast<fixed_coord_t>(std::sqrt(n) / 2));
+    cell_size_ = std::max(fixed_coord_t{1},
+                          (std::max(max_x_ - min_x_, max_y_ - min_y_) + 1 +
+                           cells_per_axis_ - 1) /
+                              cells_per_axis_);
+    cells_.resize(cells_per_axis_ * cells_per_axis_);
+    for (auto r = 0ULL; r < rings_.size(); ++r) {
+      for (auto i = 0ULL; i < rings_[r]->size(); ++i) {
+        auto const& p = (*rings_[r])[i];
+        cells_[cell(p.x(), min_x_) * cells_per_axis_ + cell(p.y(), min_y_)]
+            .emplace_back(r, i);
+      }
+    }
+  }
+
+  fixed_coord_t cell(fixed_coord_t const c, fixed_coord_t const min) const {
+    return std::clamp((c - min) / cell_size_, fixed_coord_t{0},
+                      cells_per_axis_ - 1);
+  }
+
+  void remove(size_t const r, size_t const i) { removed_[r][i] = true; }
+
+  // closed triangle (a, b, c), ignores vertex (r, i) and vertices at a and c
+  bool any_inside(fixed_xy const& a, fixed_xy const& b, fixed_xy const& c,
+                  size_t const r, size_t const i) const {
+    auto const min_x = std::min({a.x(), b.x(), c.x()});
+    auto const min_y = std::min({a.y(), b.y(), c.y()});
+    auto const max_x = std::max({a.x(), b.x(), c.x()});
+    auto const max_y = std::max({a.y(), b.y(), c.y()});
+
+    auto const cross = [](fixed_xy const& o, fixed_xy const& u,
+                          fixed_xy const& v) {
+      return static_cast<double>(u.x() - o.x()) * (v.y() - o.y()) -
+             static_cast<double>(u.y() - o.y()) * (v.x() - o.x());
+    };
+
+    for (auto cx = cell(min_x, min_x_); cx <= cell(max_x, min_x_); ++cx) {
+      for (auto cy = cell(min_y, min_y_); cy <= cell(max_y, min_y_); ++cy) {
+        for (auto const& [vr, vi] : cells_[cx * cells_per_axis_ + cy]) {
+          if (removed_[vr][vi] || (vr == r && vi == i)) {
+            continue;
+          }
+          auto const& p = (*rings_[vr])[vi];
+          if (p == a || p == c || p.x() < min_x || p.x() > max_x ||
+              p.y() < min_y || p.y() > max_y) {
+            continue;
+          }
+
+          auto const d1 = cross(a, b, p);
+          auto const d2 = cross(b, c, p);
+          auto const d3 = cross(c, a, p);
+          auto const has_neg = d1 < 0 || d2 < 0 || d3 < 0;
+          auto const has_pos = d1 > 0 || d2 > 0 || d3 > 0;
+          if (!(has_neg && has_pos)) {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  std::vector<Ring const*> const& rings_;
+  std::vector<std::vector<bool>> removed_;
+
+  fixed_coord_t min_x_{std::numeric_limits<fixed_coord_t>::max()};
+  fixed_coord_t min_y_{std::numeric_limits<fixed_coord_t>::max()};
+  fixed_coord_t max_x_{std::numeric_limits<fixed_coord_t>::min()};
+  fixed_coord_t max_y_{std::numeric_limits<fixed_coord_t>::min()};
+  fixed_coord_t cells_per_axis_{1}, cell_size_{1};
+  std::vector<std::vector<std::pair<size_t, size_t>>> cells_;
+};
+
+// Visvalingam-Whyatt: effective area of each point of closed rings, i.e. the
+// (monotonic) triangle area at the time the point would be removed
+// first/last point and the two points removed last are never removed (inf)
+// -> rings never degenerate
+//
+// topology safe: a point is not removed while another (remaining) point of
+// any of the rings lies inside the triangle it spans with its neighbors,
+// i.e. the new edge would cross another edge (valid input assumed). Such
+// points are retried once one of their neighbors was removed.
+template <typename Ring>
+std::vector<std::vector<double>> simplify_ring_areas(
+    std::vector<Ring const*> const& rings) {
+  constexpr auto const kInf = std::numeric_limits<double>::infinity();
+  constexpr auto const kBlocked = -1.;
+
+  std::vector<std::vector<double>> areas, curr;
+  std::vector<std::vector<size_t>> prev, next;
+  std::vector<size_t> remaining;
+  for (auto const* ring : rings) {
+    auto const n = ring->size();
+    areas.emplace_back(n, kInf);
+    curr.emplace_back(n, kBlocked);
+    prev.emplace_back(n);
+    next.emplace_back(n);
+    remaining.push_back(n < kSimplifyRingMinSize ? 0 : n - 2);
+    for (auto i = 0ULL; i < n; ++i) {
+      prev.back()[i] = i - 1;
+      next.back()[i] = i + 1;
+    }
+  }
+
+  auto const triangle_area = [&](size_t const r, size_t const i) {
+    auto const& ring = *rings[r];
+    auto const& a = ring[prev[r][i]];
+    auto const& b = ring[i];
+    auto const& c = ring[next[r][i]];
+    return std::abs(static_cast<double>(b.x() - a.x()) * (c.y() - a.y()) -
+                    static_cast<double>(c.x() - a.x()) * (b.y() - a.y())) /
+           2.;
+  };
+
+  using entry_t = std::tuple<double, size_t, size_t>;  // area, ring, point
+  std::priority_queue<entry_t, std::vector<entry_t>, std::greater<>> queue;
+  for (auto r = 0ULL; r < rings.size(); ++r) {
+    if (remaining[r] == 0) {
+      continue;
+    }
+    for (auto i = 1ULL; i < rings[r]->size() - 1; ++i) {
+      curr[r][i] = triangle_area(r, i);
+      queue.emplace(curr[r][i], r, i);
+    }
+  }
+
+  ring_vertex_grid<Ring> grid{rings};
+  auto max_area = 0.;
+  while (!queue.empty()) {
+    auto const [area, r, i] = queue.top();
+    queue.pop();
+    if (area != curr[r][i] || areas[r][i] != kInf || remaining[r] <= 2) {
+      continue;  // outdated entry
+    }
+
+    auto const& ring = *rings[r];
+    if (grid.any_inside(ring[prev[r][i]], ring[i], ring[next[r][i]], r, i)) {
+      curr[r][i] = kBlocked;  // retry after a neighbor was removed
+      continue;
+    }
+
+    max_area = std::max(max_area, area);
+    areas[r][i] = max_area;
+    grid.remove(r, i);
+    --remaining[r];
+
+    next[r][prev[r][i]] = next[r][i];
+    prev[r][next[r][i]] = prev[r][i];
+    for (auto const j : {prev[r][i], next[r][i]}) {
+      if (j != 0 && j != ring.size() - 1) {
+        curr[r][j] = triangle_area(r, j);
+        queue.emplace(curr[r][j], r, j);
+      }
+    }
+  }
+  return areas;
+}
+
+// outer and inner rings of all polygons (in this order)
+inline std::vector<fixed_ring const*> polygon_rings(
+    fixed_polygon const& multi_polygon) {
+  std::vector<fixed_ring const*> rings;
+  for (auto const& polygon : multi_polygon) {
+    rings.push_back(&polygon.outer());
+    for (auto const& inner : polygon.inners()) {
+      rings.push_back(&inner);
+    }
+  }
+  return rings;
+}
+
+inline fixed_geometry simplify(fixed_polygon multi_polygon,
+                               uint32_t const tolerance) {
+  auto const threshold = static_cast<double>(tolerance) * tolerance;
+  auto const areas = simplify_ring_areas(polygon_rings(multi_polygon));
+
+  auto r = 0ULL;
+  auto const simplify_ring = [&](fixed_ring& ring) {
+    fixed_ring simplified;
+    for (auto i = 0ULL; i < ring.size(); ++i) {
+      if (areas[r][i] >= threshold) {
+        simplified.emplace_back(ring[i]);
+      }
+    }
+    ring = std::move(simplified);
+    ++r;
+  };
+
+  for (auto& polygon : multi_polygon) {
+    simplify_ring(polygon.outer());
+    for (auto& inner : polygon.inners()) {
+      simplify_ring(inner);
+    }
+  }
   return multi_polygon;
 }
 
@@ -11,4 +11,7 @@ fixed_geometry deserialize(std::string_view geo,
                            std::vector<std::string_view> simplify_masks,
                            uint32_t z);
 
+// only the type: returns an empty geometry of the serialized type
+fixed_geometry deserialize_empty(std::string_view geo);
+
 }  // namespace tiles
@@ -1,54 +1,133 @@
 #pragma once
 
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "geo/tile.h"
 #include "lmdb/lmdb.hpp"
 
+#include "utl/to_vec.h"
+
+#include "tiles/bin_utils.h"
 #include "tiles/db/bq_tree.h"
 #include "tiles/db/feature_pack.h"
+#include "tiles/db/feature_pack_filter.h"
+#include "tiles/db/features_key_layout.h"
 #include "tiles/db/layer_names.h"
 #include "tiles/db/pack_file.h"
 #include "tiles/db/shared_metadata.h"
 #include "tiles/db/tile_database.h"
 #include "tiles/db/tile_index.h"
+#include "tiles/feature/aggregate_polygon_features.h"
 #include "tiles/feature/deserialize.h"
 #include "tiles/fixed/algo/bounding_box.h"
+#include "tiles/fixed/algo/clip.h"
 #include "tiles/mvt/tile_builder.h"
 #include "tiles/mvt/tile_spec.h"
 #include "tiles/perf_counter.h"
+#include "tiles/util.h"
 
 #include "boost/geometry.hpp"
 
 namespace tiles {
 
+template <typename T>
+struct queue_wrapper;
+
 struct render_ctx {
   int max_prepared_zoom_level_ = -1;
+  int pyramid_max_zoom_level_ = -1;  // see build_feature_pyramid
   bq_tree seaside_tiles_;
+  tile_key_layout features_key_layout_ = tile_key_layout::row_major;
 
   std::vector<std::string> layer_names_;
   shared_metadata_decoder metadata_decoder_;
 
   bool compress_result_ = true;
+  int compress_level_ = kCompressLevelDefault;  // prepare_tiles: max
   bool ignore_prepared_ = false;
+  bool ignore_pyramid_ = false;
+  bool ignore_feature_boxes_ = false;  // pack index instead of box prefilter
   bool ignore_fully_seaside_ = false;
 
   bool tb_render_debug_info_ = false;
   bool tb_aggregate_lines_ = false;
   bool tb_aggregate_polygons_ = false;
   bool tb_drop_subpixel_polygons_ = true;
+  bool tb_transcode_geometry_ = true;
   bool tb_print_stats_ = false;
+
+  // uncompressed tile size budget in bytes (0: unlimited), if exceeded the
+  // features with the smallest area are dropped (except coastline)
+  size_t tb_max_tile_size_ = 0;
+
+  // mvt extent per zoom level (power of two, missing: kVectorTileExtend)
+  // from the database meta (see prepare_tiles)
+  std::vector<uint32_t> tb_tile_extents_;
+
+  // if set: process the layers of one tile in parallel on this (shared) queue
+  queue_wrapper<std::function<void()>>* tb_layer_queue_ = nullptr;
 };
 
+inline uint32_t tile_extent(render_ctx const& ctx, uint32_t const z) {
+  return z < ctx.tb_tile_extents_.size() ? ctx.tb_tile_extents_[z]
+                                         : kVectorTileExtend;
+}
+
+inline void verify_tile_extents(std::vector<uint32_t> const& extents) {
+  utl::verify(extents.size() <= kMaxZoomLevel + 1, "too many tile extents");
+  for (auto const extent : extents) {
+    verify_tile_extent(extent);
+  }
+}
+
+// stored by prepare_tiles: tiles rendered on demand use the same extents
+inline std::string write_tile_extents(std::vector<uint32_t> const& extents) {
+  std::string buf;
+  for (auto const extent : extents) {
+    append(buf, extent);
+  }
+  return buf;
+}
+
+inline std::vector<uint32_t> read_tile_extents(std::string_view const buf) {
+  utl::verify(buf.size() % sizeof(uint32_t) == 0, "invalid tile extents");
+  std::vector<uint32_t> extents(buf.size() / sizeof(uint32_t));
+  for (auto i = 0ULL; i < extents.size(); ++i) {
+    extents[i] = read_nth<uint32_t>(buf.data(), i);
+  }
+  verify_tile_extents(extents);
+  return extents;
+}
+
 inline render_ctx make_render_ctx(tile_db_handle& db_handle) {
   auto txn = db_handle.make_txn();
   auto meta_dbi = db_handle.meta_dbi(txn);
 
   auto opt_max_prep = txn.get(meta_dbi, kMetaKeyMaxPreparedZoomLevel);
+  auto opt_framing = txn.get(meta_dbi, kMetaKeyPreparedTileFraming);
+  if (opt_max_prep && (!opt_framing || *opt_framing != kPreparedTileFraming)) {
+    t_log("ignoring prepared tiles (outdated format, prepare again)");
+    opt_max_prep = std::nullopt;
+  }
+  auto opt_pyramid = txn.get(meta_dbi, kMetaKeyPyramidMaxZoomLevel);
   auto opt_seaside = txn.get(meta_dbi, kMetaKeyFullySeasideTree);
-
-  return {opt_max_prep ? std::stoi(std::string{*opt_max_prep}) : -1,
-          opt_seaside ? bq_tree{*opt_seaside} : bq_tree{},
-          get_layer_names(db_handle, txn),
-          make_shared_metadata_decoder(db_handle, txn)};
+  auto seaside_tiles = opt_seaside ? bq_tree{*opt_seaside} : bq_tree{};
+  seaside_tiles.flatten();
+  auto opt_extents = txn.get(meta_dbi, kMetaKeyTileExtents);
+
+  render_ctx ctx{opt_max_prep ? std::stoi(std::string{*opt_max_prep}) : -1,
+                 opt_pyramid ? std::stoi(std::string{*opt_pyramid}) : -1,
+                 std::move(seaside_tiles),
+                 get_features_key_layout(db_handle, txn),
+                 get_layer_names(db_handle, txn),
+                 make_shared_metadata_decoder(db_handle, txn)};
+  if (opt_extents) {
+    ctx.tb_tile_extents_ = read_tile_extents(*opt_extents);
+  }
+  return ctx;
 }
 
 template <typename PerfCounter>
@@ -58,46 +137,84 @@ void render_seaside(tile_builder& builder, render_ctx const& ctx,
   auto const& seaside_tiles = ctx.seaside_tiles_.all_leafs(tile);
   stop<perf_task::RENDER_TILE_FIND_SEASIDE>(pc);
 
-  for (auto const& seaside_tile : seaside_tiles) {
-    auto const bounds = tile_spec{seaside_tile}.draw_bounds_;
-
-    fixed_simple_polygon polygon{
-        {{bounds.min_corner().x(), bounds.min_corner().y()},
-         {bounds.min_corner().x(), bounds.max_corner().y()},
-         {bounds.max_corner().x(), bounds.max_corner().y()},
-         {bounds.max_corner().x(), bounds.min_corner().y()},
-         {bounds.min_corner().x(), bounds.min_corner().y()}}};
-    boost::geometry::correct(polygon);
+  if (seaside_tiles.empty()) {
+    return;
+  }
 
-    start<perf_task::RENDER_TILE_ADD_SEASIDE>(pc);
-    builder.add_feature({tile_to_key(seaside_tile),
+  // merge the (overlapping) leaf draw bounds into few polygons first: the
+  // builder would clip, shift, and encode every single rectangle otherwise
+  start<perf_task::RENDER_TILE_ADD_SEASIDE>(pc);
+  auto geometry =
+      seaside_tiles.size() == 1
+          ? fixed_geometry{to_polygon(
+                tile_spec{seaside_tiles.front()}.draw_bounds_)}
+          : union_boxes(utl::to_vec(seaside_tiles, [](auto const& t) {
+              return tile_spec{t}.draw_bounds_;
+            }));
+
+  if (!mpark::holds_alternative<fixed_null>(geometry)) {
+    builder.add_feature({tile_to_key(tile),
                          kLayerCoastlineIdx,
                          std::pair<uint32_t, uint32_t>{0, kMaxZoomLevel + 1},
                          {{"layer", "coastline"}},
-                         fixed_polygon{std::move(polygon)}});
-    stop<perf_task::RENDER_TILE_ADD_SEASIDE>(pc);
+                         std::move(geometry)});
   }
+  stop<perf_task::RENDER_TILE_ADD_SEASIDE>(pc);
 }
 
 template <typename Fn>
 void pack_records_foreach(lmdb::cursor& c, geo::tile const& query_tile,
-                          Fn&& fn) {
-  // XXX not working on zoom level zero "whole database" ?!
-  auto const bounds = query_tile.bounds_on_z(kTileDefaultIndexZoomLvl);
-  for (auto y = bounds.miny_; y < bounds.maxy_; ++y) {
-    auto const key_begin =
-        tile_to_key(bounds.minx_, y, kTileDefaultIndexZoomLvl);
-    auto const key_end = tile_to_key(bounds.maxx_, y, kTileDefaultIndexZoomLvl);
-
+                          tile_key_layout const layout, Fn&& fn) {
+  auto const foreach_range = [&](tile_key_t const key_begin,
+                                 tile_key_t const key_end) {
     for (auto el = c.get(lmdb::cursor_op::SET_RANGE, key_begin);
          el && el->first < key_end;
          el = c.get<decltype(key_begin)>(lmdb::cursor_op::NEXT)) {
 
-      auto const result_tile = key_to_tile(el->first);
+      auto const result_tile = key_to_tile(el->first, layout);
       pack_records_foreach(el->second, [&](auto const& pack_record) {
         fn(result_tile, pack_record);
       });
     }
+  };
+
+  // one pass per index level: z4/z7 buckets hold the low zoom features
+  // deeper levels only hold features with min zoom >= level (see
+  // index_zoom_level) -> nothing visible on lower zoom levels
+  for (auto const z : kTileIndexZoomLvls) {
+    if (z != kTileIndexZoomLvls.front() && z > query_tile.z_) {
+      break;
+    }
+
+    if (layout == tile_key_layout::morton) {  // one seek
+      auto const [key_begin, key_end] = morton_key_range(query_tile, z);
+      foreach_range(key_begin, key_end);
+      continue;
+    }
+
+    // XXX not working on zoom level zero "whole database" ?!
+    auto const bounds = query_tile.bounds_on_z(z);
+    for (auto y = bounds.miny_; y < bounds.maxy_; ++y) {
+      foreach_range(tile_to_key(bounds.minx_, y, z),
+                    tile_to_key(bounds.maxx_, y, z));
+    }
+  }
+}
+
+inline bool use_pyramid(render_ctx const& ctx, geo::tile const& tile) {
+  return !ctx.ignore_pyramid_ &&
+         static_cast<int>(tile.z_) <= ctx.pyramid_max_zoom_level_;
+}
+
+// the one generalized pack of the tile (missing: no features on this tile)
+template <typename Fn>
+void pyramid_records_foreach(tile_db_handle& handle, lmdb::txn& txn,
+                             geo::tile const& tile, Fn&& fn) {
+  auto pyramid_dbi = handle.pyramid_dbi(txn);
+  if (auto const records = txn.get(pyramid_dbi, tile_to_key(tile)); records) {
+    pack_records_foreach(*records, [&](auto const& pack_record) {
+      fn(tile, pack_record);
+    });
   }
 }
 
@@ -106,18 +223,29 @@ size_t render_features(tile_builder& builder, render_ctx const& ctx,
                        geo::tile const& tile, ForeachPack&& foreach_pack,
                        PerfCounter& pc) {
   size_t added_features = 0;
-  auto const box = tile_spec{tile}.draw_bounds_;  // XXX really with overdraw?
+  size_t scanned_bytes = 0;  // feature bytes passing the pack index
+  size_t scanned_features = 0;
+  auto const spec = tile_spec{tile};
+  auto const& box = spec.draw_bounds_;  // XXX really with overdraw?
 
   start<perf_task::RENDER_TILE_QUERY_FEATURE>(pc);
   foreach_pack([&](auto const& db_tile, auto const& pack_str) {
     stop<perf_task::RENDER_TILE_QUERY_FEATURE>(pc);
     stop<perf_task::RENDER_TILE_ITER_FEATURE>(pc);
 
-    unpack_features(db_tile, pack_str, tile, [&](auto const& feature_str) {
+    auto const on_feature = [&](auto const& feature_str) {
+      scanned_bytes += feature_str.size();
+      ++scanned_features;
       start<perf_task::RENDER_TILE_DESER_FEATURE_OKAY>(pc);
       start<perf_task::RENDER_TILE_DESER_FEATURE_SKIP>(pc);
       auto const feature =
-          deserialize_feature(feature_str, ctx.metadata_decoder_, box, tile.z_);
+          deserialize_feature(feature_str, ctx.metadata_decoder_, box, tile.z_,
+                              ctx.tb_transcode_geometry_,
+                              home_bucket_hint{spec.insert_bounds_.min_corner(),
+                                               db_tile},
+                              ctx.tb_drop_subpixel_polygons_ &&
+                                  ctx.tb_aggregate_polygons_ &&
+                                  tile.z_ > kAggregatePolygonMaxZoomLevel);
       if (!feature) {
         stop<perf_task::RENDER_TILE_DESER_FEATURE_SKIP>(pc);
         start<perf_task::RENDER_TILE_ITER_FEATURE>(pc);
@@ -126,13 +254,23 @@ size_t render_features(tile_builder& builder, render_ctx const& ctx,
       stop<perf_task::RENDER_TILE_DESER_FEATURE_OKAY>(pc);
 
       start<perf_task::RENDER_TILE_ADD_FEATURE>(pc);
-      builder.add_feature(std::move(*feature));
-      ++added_features;
+      if (builder.add_feature(std::move(*feature))) {
+        ++added_features;  // see ignore_fully_seaside_
+      }
       stop<perf_task::RENDER_TILE_ADD_FEATURE>(pc);
-    });
+    };
+
+    // the r-tree (see pack_index) replaces the box prefilter
+    if (ctx.ignore_feature_boxes_ ||
+        find_segment_offset(pack_str, kHilbertRTreeIndexId).has_value() ||
+        !unpack_selected_features(pack_str, box, tile.z_, on_feature)) {
+      unpack_features(db_tile, pack_str, tile, box, on_feature);
+    }
 
     start<perf_task::RENDER_TILE_ITER_FEATURE>(pc);
   });
+  pc.template append<perf_task::RESULT_SCANNED_BYTES>(scanned_bytes);
+  pc.template append<perf_task::RESULT_SCANNED_FEATURES>(scanned_features);
   return added_features;
 }
 
@@ -165,7 +303,7 @@ std::optional<std::string> get_tile(render_ctx const& ctx,
 
   if (ctx.compress_result_) {
     start<perf_task::GET_TILE_COMPRESS>(pc);
-    auto compressed = compress_deflate(rendered_tile);
+    auto compressed = compress_tile(rendered_tile, ctx.compress_level_);
     stop<perf_task::GET_TILE_COMPRESS>(pc);
     pc.template append<perf_task::RESULT_SIZE>(compressed.size());
     return {std::move(compressed)};
@@ -208,9 +346,15 @@ std::optional<std::string> get_tile(tile_db_handle& handle, lmdb::txn& txn,
   return get_tile(
       ctx, tile,
       [&](auto&& fn) {
-        pack_records_foreach(features_cursor, tile, [&](auto t, auto r) {
-          fn(t, pack_handle.get(r));
-        });
+        auto const fn_pack = [&](auto t, auto r) {
+          fn(t, pack_handle.get(r).view());
+        };
+        if (use_pyramid(ctx, tile)) {
+          pyramid_records_foreach(handle, txn, tile, fn_pack);
+        } else {
+          pack_records_foreach(features_cursor, tile, ctx.features_key_layout_,
+                               fn_pack);
+        }
       },
       pc);
 }
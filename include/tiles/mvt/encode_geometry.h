@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string_view>
+#include <vector>
+
 #include "protozero/pbf_builder.hpp"
 
 #include "tiles/fixed/fixed_geometry.h"
@@ -12,4 +15,12 @@ namespace tiles {
 void encode_geometry(protozero::pbf_builder<tags::mvt::Feature>&,
                      fixed_geometry const&, tile_spec const&);
 
+// fused deserialize -> simplify -> shift -> encode for serialized geometry
+// (see fixed/io/serialize.h) which needs no clipping (inside draw bounds)
+// returns false if nothing was left to encode (feature should be dropped)
+bool transcode_geometry(protozero::pbf_builder<tags::mvt::Feature>&,
+                        std::string_view geo,
+                        std::vector<std::string_view> const& simplify_masks,
+                        tile_spec const&);
+
 }  // namespace tiles
@@ -19,7 +19,8 @@ struct tile_builder {
   tile_builder& operator=(tile_builder const&) = delete;
   tile_builder& operator=(tile_builder&&) noexcept = default;
 
-  void add_feature(feature);
+  // false: dropped right away (e.g. everything removed by the simplify mask)
+  bool add_feature(feature);
 
   std::string finish();
 
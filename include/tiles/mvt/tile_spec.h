@@ -13,9 +13,22 @@ namespace tiles {
 constexpr auto kOverdraw = 4096;
 // constexpr auto kOverdraw = 128;
 
+constexpr uint32_t kVectorTileExtend = 4096;
+
+inline void verify_tile_extent(uint32_t const extent) {
+  utl::verify(extent > 0 && extent <= kVectorTileExtend &&
+                  (extent & (extent - 1)) == 0,
+              "invalid tile extent {}", extent);
+}
+
 struct tile_spec {
-  explicit tile_spec(geo::tile tile) : tile_{tile} {
+  explicit tile_spec(geo::tile tile, uint32_t extent = kVectorTileExtend)
+      : tile_{tile}, extent_{extent} {
     utl::verify(kMaxZoomLevel >= tile.z_, "invalid z");
+    verify_tile_extent(extent);
+    while ((extent << extent_shift_) < kVectorTileExtend) {
+      ++extent_shift_;
+    }
     auto delta_z = kMaxZoomLevel - tile.z_;
 
     utl::verify(tile.x_ < (1ULL << tile.z_) && tile.y_ < (1ULL << tile.z_),
@@ -45,7 +58,13 @@ struct tile_spec {
   }
 
   geo::tile tile_;
-  fixed_box px_bounds_{};  // on tile z
+
+  // mvt extent of the tile: pixel coordinates are quantized by extent_shift_
+  // (see shift) -> fewer distinct vertices and smaller deltas on low zoom
+  uint32_t extent_;
+  uint32_t extent_shift_{0};
+
+  fixed_box px_bounds_{};  // on tile z (extent 4096)
   fixed_box insert_bounds_{}, draw_bounds_{};  // z lvl 20
 };
 
@@ -11,6 +11,8 @@ namespace tiles {
 namespace perf_task {
 enum perf_task_t : uint32_t {
   RESULT_SIZE,
+  RESULT_SCANNED_BYTES,
+  RESULT_SCANNED_FEATURES,
 
   GET_TILE_TOTAL,
   GET_TILE_FETCH,
@@ -7,8 +7,10 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "fmt/core.h"
@@ -33,7 +35,42 @@ inline void t_log(Args&&... args) {
   std::clog << std::endl;
 }
 
-std::string compress_deflate(std::string const&);
+constexpr auto const kCompressLevelFast = 1;
+constexpr auto const kCompressLevelDefault = 6;
+constexpr auto const kCompressLevelMax = 9;
+
+// zlib stream which keeps its state (and allocations) between calls
+struct deflate_compressor {
+  explicit deflate_compressor(int level);
+  ~deflate_compressor();
+
+  deflate_compressor(deflate_compressor const&) = delete;
+  deflate_compressor(deflate_compressor&&) noexcept = default;
+  deflate_compressor& operator=(deflate_compressor const&) = delete;
+  deflate_compressor& operator=(deflate_compressor&&) noexcept = default;
+
+  std::string compress(std::string const&);
+
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
+
+// uses one deflate_compressor per thread and level
+std::string compress_deflate(std::string const&,
+                             int level = kCompressLevelMax);
+
+enum class content_encoding { deflate, gzip, identity };  // cheapest first
+
+// rendered / prepared tiles: zlib stream + gzip trailer (crc32, size)
+// -> every content encoding without compressing again (see encode_tile)
+std::string compress_tile(std::string const&, int level = kCompressLevelMax);
+std::string encode_tile(std::string_view compressed_tile, content_encoding);
+
+// encoding with the highest q value of an Accept-Encoding header (ties:
+// cheapest first), nullopt: nothing acceptable
+std::optional<content_encoding> select_content_encoding(
+    std::string_view accept_encoding);
+char const* to_str(content_encoding);
 
 struct progress_tracker {
 #ifdef TILES_GLOBAL_PROGRESS_TRACKER
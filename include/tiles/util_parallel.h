@@ -1,9 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <functional>
+#include <iostream>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -122,6 +128,8 @@ struct queue_wrapper {
     return queue_.wait_dequeue_timed(t, std::chrono::milliseconds(10));
   }
 
+  bool try_dequeue(T& t) { return queue_.try_dequeue(t); }
+
   void dequeue_bulk(std::vector<T>& vec) {
     size_t count = queue_.wait_dequeue_bulk_timed(
         vec.data(), vec.size(), std::chrono::milliseconds(10));
@@ -180,6 +188,66 @@ struct queue_processor {
   std::vector<std::thread> threads_;
 };
 
+// run the tasks on the queue workers and the calling thread
+// (the caller may itself be a task: all workers may be waiting)
+//
+// queue entries only claim the next unclaimed task of this call: the caller
+// never runs tasks of other calls (other tiles, nested calls) while waiting.
+// entries left after all tasks were claimed are no-ops.
+inline void process_and_wait(queue_wrapper<std::function<void()>>& queue,
+                             std::vector<std::function<void()>> tasks) {
+  struct state {
+    explicit state(std::vector<std::function<void()>> tasks)
+        : tasks_{std::move(tasks)}, errors_(tasks_.size()) {}
+
+    bool run_next() {
+      auto const i = next_++;
+      if (i >= tasks_.size()) {
+        return false;
+      }
+
+      try {
+        tasks_[i]();
+      } catch (...) {
+        errors_[i] = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> l{mutex_};
+      if (++done_ == tasks_.size()) {
+        cv_.notify_all();
+      }
+      return true;
+    }
+
+    std::vector<std::function<void()>> tasks_;
+    std::vector<std::exception_ptr> errors_;
+    std::atomic_size_t next_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t done_{0};
+  };
+
+  auto const s = std::make_shared<state>(std::move(tasks));
+  for (auto i = 1ULL; i < s->tasks_.size(); ++i) {  // caller takes one
+    queue.enqueue([s] { s->run_next(); });
+  }
+
+  while (s->run_next()) {
+  }
+
+  {  // tasks claimed by workers are running: nothing else to help with
+    std::unique_lock<std::mutex> l{s->mutex_};
+    s->cv_.wait(l, [&] { return s->done_ == s->tasks_.size(); });
+  }
+
+  for (auto const& e : s->errors_) {
+    if (e) {
+      std::rethrow_exception(e);
+    }
+  }
+}
+
 // template <typename Task, uint64_t MaxInFlight = 64>
 // struct throttling_source {
 //   static_assert(MaxInFlight > 0);
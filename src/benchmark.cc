@@ -1,17 +1,26 @@
 #include <cstdlib>
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <numeric>
 #include <random>
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 #include "conf/configuration.h"
 #include "conf/options_parser.h"
 
 #include "fmt/core.h"
 #include "fmt/ostream.h"
 
+#include "tiles/db/pack_compression.h"
 #include "tiles/db/tile_database.h"
 #include "tiles/get_tile.h"
 #include "tiles/perf_counter.h"
+#include "tiles/util.h"
 
 namespace tiles {
 
@@ -22,13 +31,152 @@ struct benchmark_settings : public conf::configuration {
           "xyz coords of a single tile, z for all tiles on a certain zoom "
           "level, if not present random smaple");
     param(compress_, "compress", "compress the tiles");
+    param(compress_level_, "compress_level", "deflate level (0-9)");
+    param(compress_levels_, "compress_levels",
+          "compare all deflate levels on the rendered sample tiles");
+    param(max_tile_size_, "max_tile_size",
+          "byte budget per tile (0: unlimited)");
+    param(query_cost_, "query_cost",
+          "measure feature index queries on z0-z10 (current key layout)");
+    param(seaside_, "seaside",
+          "compare seaside lookups: flat index vs. tree walk");
+    param(ignore_pyramid_, "ignore_pyramid",
+          "render low zoom levels from the full resolution features");
+    param(ignore_feature_boxes_, "ignore_feature_boxes",
+          "query packs with the pack index instead of the box prefilter "
+          "(packs with a hilbert r-tree always use it)");
+    param(cold_cache_, "cold_cache",
+          "drop the pack file from the page cache before every tile");
   }
 
   std::string db_fname_{"tiles.mdb"};
   std::vector<uint32_t> tile_;
   bool compress_{true};
+  int compress_level_{kCompressLevelDefault};
+  bool compress_levels_{false};
+  size_t max_tile_size_{0};
+  bool query_cost_{false};
+  bool seaside_{false};
+  bool ignore_pyramid_{false};
+  bool ignore_feature_boxes_{false};
+  bool cold_cache_{false};
 };
 
+void benchmark_compress_levels(std::vector<std::string> const& tiles) {
+  auto const raw_size = std::accumulate(
+      begin(tiles), end(tiles), 0ULL,
+      [](auto acc, auto const& t) { return acc + t.size(); });
+  fmt::print(std::cout, "=== compress {} tiles ({})\n",
+             printable_num{tiles.size()}, printable_bytes{raw_size});
+
+  for (auto level = kCompressLevelFast; level <= kCompressLevelMax; ++level) {
+    using namespace std::chrono;
+    auto const start = steady_clock::now();
+    size_t size = 0;
+    for (auto const& tile : tiles) {
+      size += compress_deflate(tile, level).size();
+    }
+    auto const dur = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+    fmt::print(std::cout, "level {} | {} total (avg. {}) | {} ({:.1f}%)\n",
+               level, printable_ns{dur.count()},
+               printable_ns{static_cast<double>(dur.count()) / tiles.size()},
+               printable_bytes{size}, 100. * size / raw_size);
+  }
+}
+
+// cold cache renders (e.g. compressed vs. uncompressed packs), linux only
+void drop_page_cache(pack_handle& pack_handle) {
+#ifdef __linux__
+  if (pack_handle.dat_.empty()) {
+    return;
+  }
+  madvise(pack_handle.dat_.data(), pack_handle.dat_.size(), MADV_DONTNEED);
+  posix_fadvise(fileno(pack_handle.file_), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+void benchmark_seaside(bq_tree const& flat_tree) {
+  bq_tree const walk_tree{flat_tree.nodes_};  // same tree without flat index
+
+  std::vector<geo::tile> tiles;
+  std::mt19937 g(31337);
+  for (auto z = 10U; z <= 18U; ++z) {
+    std::uniform_int_distribution<uint32_t> dist{0, (1U << z) - 1};
+    for (auto i = 0; i < 100'000; ++i) {
+      tiles.emplace_back(dist(g), dist(g), z);
+    }
+  }
+  fmt::print(std::cout, "=== seaside lookups ({} random tiles z10-z18)\n",
+             printable_num{tiles.size()});
+
+  auto const run = [&](char const* label, bq_tree const& tree) {
+    using namespace std::chrono;
+    auto const start = steady_clock::now();
+    size_t contained = 0, leafs = 0;
+    for (auto const& tile : tiles) {
+      contained += tree.contains(tile) ? 1 : 0;
+      leafs += tree.all_leafs(tile).size();
+    }
+    auto const dur = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+    fmt::print(std::cout, "{} | {} total (avg. {}) | {} contained {} leafs\n",
+               label, printable_ns{dur.count()},
+               printable_ns{static_cast<double>(dur.count()) / tiles.size()},
+               printable_num{contained}, printable_num{leafs});
+  };
+  run("tree walk ", walk_tree);
+  run("flat index", flat_tree);
+}
+
+void benchmark_query_cost(tile_db_handle& db_handle, render_ctx const& ctx) {
+  auto txn = db_handle.make_txn();
+  auto features_dbi = db_handle.features_dbi(txn);
+  auto features_cursor = lmdb::cursor{txn, features_dbi};
+
+  fmt::print(std::cout, "=== feature index queries (layout: {})\n",
+             to_str(ctx.features_key_layout_));
+
+  std::mt19937 g(31337);
+  for (auto z = 0U; z <= kTileDefaultIndexZoomLvl; ++z) {
+    std::vector<geo::tile> tiles;
+    if (z <= 4) {
+      for (auto const& tile : geo::make_tile_range(z)) {
+        tiles.push_back(tile);
+      }
+    } else {
+      std::uniform_int_distribution<uint32_t> dist{0, (1U << z) - 1};
+      for (auto i = 0; i < 256; ++i) {
+        tiles.emplace_back(dist(g), dist(g), z);
+      }
+    }
+
+    using namespace std::chrono;
+    auto const start = steady_clock::now();
+    size_t records = 0;
+    for (auto const& tile : tiles) {
+      pack_records_foreach(features_cursor, tile, ctx.features_key_layout_,
+                           [&](auto const&, auto const&) { ++records; });
+    }
+    auto const dur = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+    auto seeks = 0U;
+    for (auto const lvl : kTileIndexZoomLvls) {
+      if (lvl != kTileIndexZoomLvls.front() && lvl > z) {
+        break;  // see pack_records_foreach
+      }
+      seeks += ctx.features_key_layout_ == tile_key_layout::morton
+                   ? 1U
+                   : (1U << (std::max(lvl, z) - z));  // rows of index tiles
+    }
+    fmt::print(std::cout, "z {:>2} | {} queries | avg. {} | {} seeks/query | {}"
+               " records\n",
+               z, printable_num{tiles.size()},
+               printable_ns{static_cast<double>(dur.count()) / tiles.size()},
+               seeks, printable_num{records});
+  }
+}
+
 int run_tiles_benchmark(int argc, char const** argv) {
   benchmark_settings opt;
 
@@ -52,12 +200,22 @@ int run_tiles_benchmark(int argc, char const** argv) {
   lmdb::env db_env = make_tile_database(opt.db_fname_.c_str());
   tile_db_handle db_handle{db_env};
   pack_handle pack_handle{opt.db_fname_.c_str()};
+  load_pack_dictionary(db_handle, pack_handle);
 
   auto render_ctx = make_render_ctx(db_handle);
   render_ctx.ignore_prepared_ = true;
-  render_ctx.compress_result_ = opt.compress_;
+  render_ctx.ignore_pyramid_ = opt.ignore_pyramid_;
+  render_ctx.ignore_feature_boxes_ = opt.ignore_feature_boxes_;
+  render_ctx.compress_result_ = opt.compress_ && !opt.compress_levels_;
+  render_ctx.compress_level_ = opt.compress_level_;
+  render_ctx.tb_max_tile_size_ = opt.max_tile_size_;
+  std::vector<std::string> rendered_tiles;  // for compress_levels
 
-  if (opt.tile_.empty()) {
+  if (opt.seaside_) {
+    benchmark_seaside(render_ctx.seaside_tiles_);
+  } else if (opt.query_cost_) {
+    benchmark_query_cost(db_handle, render_ctx);
+  } else if (opt.tile_.empty()) {
     geo::latlng p1{49.83, 8.55};
     geo::latlng p2{50.13, 8.74};
 
@@ -77,12 +235,22 @@ int run_tiles_benchmark(int argc, char const** argv) {
 
       perf_counter pc;
       for (auto const& tile : geo::make_tile_range(p1, p2, z)) {
+        if (opt.cold_cache_) {
+          drop_page_cache(pack_handle);
+        }
         auto rendered_tile = get_tile(db_handle, txn, features_cursor,
                                       pack_handle, render_ctx, tile, pc);
+        if (opt.compress_levels_ && rendered_tile) {
+          rendered_tiles.emplace_back(std::move(*rendered_tile));
+        }
         // break;
       }
       perf_report_get_tile(pc);
     }
+
+    if (opt.compress_levels_) {
+      benchmark_compress_levels(rendered_tiles);
+    }
   } else if (opt.tile_.size() == 1) {
     auto const z = opt.tile_.front();
     t_log("render entire zoom level: {}", z);
@@ -1,5 +1,6 @@
 #include "tiles/db/bq_tree.h"
 
+#include <algorithm>
 #include <array>
 #include <map>
 #include <stack>
@@ -93,11 +94,19 @@ std::pair<std::optional<bool>, bq_node_t> bq_tree::find_parent_leaf(
 }
 
 bool bq_tree::contains(geo::tile const& q) const {
+  if (auto const flat = flat_contains(q); flat.has_value()) {
+    return *flat;
+  }
+
   auto const decision = find_parent_leaf(q).first;
   return decision.has_value() ? *decision : false;
 }
 
 std::vector<geo::tile> bq_tree::all_leafs(geo::tile const& q) const {
+  if (auto flat = flat_all_leafs(q); flat.has_value()) {
+    return std::move(*flat);
+  }
+
   auto const parent = find_parent_leaf(q);
   auto const& decision = parent.first;
   if (decision.has_value()) {
@@ -132,6 +141,104 @@ std::vector<geo::tile> bq_tree::all_leafs(geo::tile const& q) const {
   return result;
 }
 
+// morton code of the upper left corner of the tile on level 32
+inline uint64_t morton_code(geo::tile const& t) {
+  auto const spread = [](uint64_t v) {
+    v = (v | (v << 16U)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8U)) & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4U)) & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2U)) & 0x3333333333333333ULL;
+    v = (v | (v << 1U)) & 0x5555555555555555ULL;
+    return v;
+  };
+  return spread(static_cast<uint64_t>(t.x_) << (32U - t.z_)) |
+         (spread(static_cast<uint64_t>(t.y_) << (32U - t.z_)) << 1U);
+}
+
+inline size_t flat_idx(uint32_t const x, uint32_t const y, uint32_t const z) {
+  return (static_cast<size_t>(y) << z) + x;
+}
+
+void bq_tree::flatten(uint32_t const z) {
+  utl::verify(z > 0 && z <= 16, "bq_tree::flatten invalid zoom level");
+
+  flat_ = std::nullopt;  // all_leafs would use the old index otherwise
+  bq_flat_index flat{z, {}, {}, {}};
+  flat.full_.resize(flat_idx(0, 1U << z, z), false);
+  flat.partial_.resize(flat.full_.size(), false);
+
+  for (auto const& leaf : all_leafs({0, 0, 0})) {
+    if (leaf.z_ <= z) {
+      auto const bounds = leaf.bounds_on_z(z);
+      for (auto y = bounds.miny_; y < bounds.maxy_; ++y) {
+        for (auto x = bounds.minx_; x < bounds.maxx_; ++x) {
+          flat.full_[flat_idx(x, y, z)] = true;
+        }
+      }
+    } else {
+      auto const shift = leaf.z_ - z;
+      flat.partial_[flat_idx(leaf.x_ >> shift, leaf.y_ >> shift, z)] = true;
+      flat.deep_leafs_.emplace_back(morton_code(leaf), leaf);
+    }
+  }
+  std::sort(begin(flat.deep_leafs_), end(flat.deep_leafs_));
+
+  flat_ = std::move(flat);
+}
+
+std::optional<bool> bq_tree::flat_contains(geo::tile const& q) const {
+  if (!flat_.has_value() || q.z_ < flat_->z_) {
+    return std::nullopt;
+  }
+
+  auto const shift = q.z_ - flat_->z_;
+  auto const idx = flat_idx(q.x_ >> shift, q.y_ >> shift, flat_->z_);
+  if (flat_->full_[idx]) {
+    return true;
+  }
+  if (!flat_->partial_[idx]) {
+    return false;
+  }
+
+  // leafs are disjoint: only the last leaf starting before q may contain it
+  auto const& leafs = flat_->deep_leafs_;
+  auto const code = morton_code(q);
+  auto it = std::upper_bound(
+      begin(leafs), end(leafs), code,
+      [](auto const& lhs, auto const& rhs) { return lhs < rhs.first; });
+  if (it == begin(leafs)) {
+    return false;
+  }
+  auto const& leaf = std::prev(it)->second;
+  return leaf.z_ <= q.z_ && (q.x_ >> (q.z_ - leaf.z_)) == leaf.x_ &&
+         (q.y_ >> (q.z_ - leaf.z_)) == leaf.y_;
+}
+
+std::optional<std::vector<geo::tile>> bq_tree::flat_all_leafs(
+    geo::tile const& q) const {
+  auto const decision = flat_contains(q);
+  if (!decision.has_value()) {
+    return std::nullopt;
+  }
+  if (*decision) {
+    return std::vector<geo::tile>{q};
+  }
+
+  // all leafs inside q form a contiguous range in morton order
+  auto const& leafs = flat_->deep_leafs_;
+  auto const code_begin = morton_code(q);
+  auto const code_end = code_begin + (1ULL << (2U * (32U - q.z_)));
+  auto it = std::lower_bound(
+      begin(leafs), end(leafs), code_begin,
+      [](auto const& lhs, auto const& rhs) { return lhs.first < rhs; });
+
+  std::vector<geo::tile> result;
+  for (; it != end(leafs) && it->first < code_end; ++it) {
+    result.push_back(it->second);
+  }
+  return result;
+}
+
 std::string_view bq_tree::string_view() const {
   return std::string_view{reinterpret_cast<char const*>(nodes_.data()),
                           nodes_.size() * sizeof(bq_node_t)};
@@ -71,7 +71,8 @@ void database_stats(tile_db_handle& db_handle, pack_handle& pack_handle) {
   for (auto el = fc.get<tile_key_t>(lmdb::cursor_op::FIRST); el;
        el = fc.get<tile_key_t>(lmdb::cursor_op::NEXT)) {
     pack_records_foreach(el->second, [&](auto record) {
-      auto const pack = pack_handle.get(record);
+      auto const data = pack_handle.get(record);
+      auto const pack = data.view();
       utl::verify(feature_pack_valid(pack),  //
                   "have invalid feature pack {}", el->first);
 
@@ -14,6 +14,9 @@
 
 #include "tiles/bin_utils.h"
 #include "tiles/db/feature_pack_quadtree.h"
+#include "tiles/db/feature_pyramid.h"
+#include "tiles/db/pack_compression.h"
+#include "tiles/db/features_key_layout.h"
 #include "tiles/db/pack_file.h"
 #include "tiles/db/quad_tree.h"
 #include "tiles/db/repack_features.h"
@@ -54,21 +57,85 @@ std::string pack_features(std::vector<std::string> const& serialized_features) {
   return p.buf_;
 }
 
+constexpr auto const kPackIndexQuadTree = "quad_tree";
+constexpr auto const kPackIndexHilbertRTree = "hilbert_rtree";
+
+char const* to_str(pack_index const index) {
+  switch (index) {
+    case pack_index::quad_tree: return kPackIndexQuadTree;
+    case pack_index::hilbert_rtree: return kPackIndexHilbertRTree;
+    default: throw utl::fail("to_str: unknown pack_index");
+  }
+}
+
+pack_index parse_pack_index(std::string_view const str) {
+  for (auto const index : {pack_index::quad_tree, pack_index::hilbert_rtree}) {
+    if (str == to_str(index)) {
+      return index;
+    }
+  }
+  throw utl::fail("parse_pack_index: unknown index {}", str);
+}
+
 std::string pack_features(geo::tile const& tile,
                           shared_metadata_coder const& metadata_coder,
-                          std::vector<std::string> const& packs) {
-  quadtree_feature_packer p{tile, metadata_coder};
+                          std::vector<std::string> const& packs,
+                          pack_index const index) {
+  quadtree_feature_packer p{tile, metadata_coder, index};
   p.pack_features(packs);
   p.finish();
   return p.packer_.buf_;
 }
 
-void pack_features(tile_db_handle& db_handle, pack_handle& pack_handle) {
+std::vector<std::string> sample_packs(tile_db_handle& db_handle,
+                                      pack_handle const& pack_handle) {
+  constexpr auto const kSampleCount = 256ULL;
+
+  std::vector<pack_record> records;
+  {
+    auto txn = db_handle.make_txn();
+    auto feature_dbi = db_handle.features_dbi(txn);
+    lmdb::cursor c{txn, feature_dbi};
+    for (auto el = c.get<tile_key_t>(lmdb::cursor_op::FIRST); el;
+         el = c.get<tile_key_t>(lmdb::cursor_op::NEXT)) {
+      pack_records_foreach(el->second,
+                           [&](auto const& r) { records.push_back(r); });
+    }
+  }
+
+  std::vector<std::string> samples;
+  auto const stride = std::max(1ULL, records.size() / kSampleCount);
+  for (auto i = 0ULL; i < records.size(); i += stride) {
+    samples.emplace_back(pack_handle.get(records[i]).view());
+  }
+  return samples;
+}
+
+void pack_features(tile_db_handle& db_handle, pack_handle& pack_handle,
+                   pack_codec const codec, pack_index const index) {
   auto const metadata_coder = make_shared_metadata_coder(db_handle);
+
+  std::string dictionary;
+  if (codec == pack_codec::deflate_dict) {
+    dictionary = train_pack_dictionary(sample_packs(db_handle, pack_handle));
+    t_log("pack dictionary: {}", printable_bytes{dictionary.size()});
+  }
+
   pack_features(db_handle, pack_handle,
                 [&](auto const tile, auto const& packs) {
-                  return pack_features(tile, metadata_coder, packs);
+                  auto pack = pack_features(tile, metadata_coder, packs, index);
+                  return codec == pack_codec::none
+                             ? pack
+                             : compress_pack(pack, dictionary);
                 });
+
+  // old packs (old dictionary) are read until here
+  auto txn = db_handle.make_txn();
+  auto meta_dbi = db_handle.meta_dbi(txn);
+  txn.put(meta_dbi, kMetaKeyPackCodec, to_str(codec));
+  txn.put(meta_dbi, kMetaKeyPackDictionary, dictionary);
+  txn.commit();
+  pack_handle.dictionary_ = std::move(dictionary);
 }
 
 void pack_features(
@@ -78,12 +145,13 @@ void pack_features(
   std::vector<tile_record> tasks;
   {
     auto txn = db_handle.make_txn();
+    auto const layout = get_features_key_layout(db_handle, txn);
     auto feature_dbi = db_handle.features_dbi(txn);
     lmdb::cursor c{txn, feature_dbi};
 
     for (auto el = c.get<tile_key_t>(lmdb::cursor_op::FIRST); el;
          el = c.get<tile_key_t>(lmdb::cursor_op::NEXT)) {
-      auto tile = key_to_tile(el->first);
+      auto tile = key_to_tile(el->first, layout);
       auto records = pack_records_deserialize(el->second);
       utl::verify(!records.empty(), "pack_features: empty pack_records");
 
@@ -94,7 +162,10 @@ void pack_features(
       }
     }
 
+    // the dbi is rebuilt from scratch anyway -> switch to the default layout
     txn.dbi_clear(feature_dbi);
+    set_features_key_layout(db_handle, txn, kDefaultFeaturesKeyLayout);
+    clear_feature_pyramid(db_handle, txn);
     txn.commit();
   }
 
@@ -107,7 +178,9 @@ void pack_features(
                                  auto txn = db_handle.make_txn();
                                  auto feature_dbi = db_handle.features_dbi(txn);
                                  for (auto const& [tile, records] : updates) {
-                                   txn.put(feature_dbi, tile_to_key(tile),
+                                   txn.put(feature_dbi,
+                                           tile_to_key(
+                                               tile, kDefaultFeaturesKeyLayout),
                                            pack_records_serialize(records));
                                  }
                                  txn.commit();
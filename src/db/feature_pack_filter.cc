@@ -0,0 +1,85 @@
+#include "tiles/db/feature_pack_filter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "utl/verify.h"
+
+#include "tiles/bin_utils.h"
+
+namespace tiles {
+
+constexpr size_t kSelectionBlockSize = 64;
+
+template <typename T>
+void read_block(char const* column, size_t const offset, size_t const count,
+                std::array<T, kSelectionBlockSize>& block) {
+  std::memcpy(block.data(), column + offset * sizeof(T), count * sizeof(T));
+}
+
+std::optional<feature_selection> select_features(std::string_view const pack,
+                                                 fixed_box const& box,
+                                                 uint32_t const z) {
+  auto const offset = find_segment_offset(pack, kFeatureBoxesId);
+  if (!offset) {
+    return std::nullopt;
+  }
+
+  utl::verify(pack.size() >= *offset + sizeof(uint32_t),
+              "select_features: invalid offset");
+  auto const n = size_t{read<uint32_t>(pack.data(), *offset)};
+  auto const row_size = 2 * sizeof(uint8_t) + 4 * sizeof(uint32_t);
+  utl::verify(pack.size() >= *offset + sizeof(uint32_t) + n * row_size,
+              "select_features: invalid feature count");
+
+  auto const min_z_col = pack.data() + *offset + sizeof(uint32_t);
+  auto const max_z_col = min_z_col + n;
+  auto const min_x_col = max_z_col + n;
+  auto const min_y_col = min_x_col + n * sizeof(uint32_t);
+  auto const max_x_col = min_y_col + n * sizeof(uint32_t);
+  auto const max_y_col = max_x_col + n * sizeof(uint32_t);
+
+  // same clamping as in the packer -> overlaps are preserved
+  auto const clamp = [](fixed_coord_t const c) {
+    return static_cast<uint32_t>(std::clamp(c, kFixedCoordMin, kFixedCoordMax));
+  };
+  auto const q_min_x = clamp(box.min_corner().x());
+  auto const q_min_y = clamp(box.min_corner().y());
+  auto const q_max_x = clamp(box.max_corner().x());
+  auto const q_max_y = clamp(box.max_corner().y());
+  auto const q_z = static_cast<uint8_t>(std::min(z, 255U));
+
+  feature_selection selection((n + kSelectionBlockSize - 1) /
+                              kSelectionBlockSize);
+
+  std::array<uint8_t, kSelectionBlockSize> min_z{}, max_z{}, match{};
+  std::array<uint32_t, kSelectionBlockSize> min_x{}, min_y{}, max_x{}, max_y{};
+  for (auto i = 0ULL; i < selection.size(); ++i) {
+    auto const begin = i * kSelectionBlockSize;
+    auto const count = std::min(kSelectionBlockSize, n - begin);
+    read_block(min_z_col, begin, count, min_z);
+    read_block(max_z_col, begin, count, max_z);
+    read_block(min_x_col, begin, count, min_x);
+    read_block(min_y_col, begin, count, min_y);
+    read_block(max_x_col, begin, count, max_x);
+    read_block(max_y_col, begin, count, max_y);
+
+    // branchless -> vectorized by the compiler
+    for (auto j = 0ULL; j < kSelectionBlockSize; ++j) {
+      match[j] = static_cast<uint8_t>(
+          (min_z[j] <= q_z) & (max_z[j] >= q_z) &  //
+          (min_x[j] <= q_max_x) & (max_x[j] >= q_min_x) &  //
+          (min_y[j] <= q_max_y) & (max_y[j] >= q_min_y));
+    }
+
+    uint64_t bits = 0;
+    for (auto j = 0ULL; j < count; ++j) {
+      bits |= static_cast<uint64_t>(match[j]) << j;
+    }
+    selection[i] = bits;
+  }
+  return selection;
+}
+
+}  // namespace tiles
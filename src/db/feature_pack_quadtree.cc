@@ -1,10 +1,16 @@
 #include "tiles/db/feature_pack_quadtree.h"
 
+#include <algorithm>
+#include <optional>
+#include <tuple>
+
 #include "utl/equal_ranges.h"
+#include "utl/equal_ranges_linear.h"
 #include "utl/to_vec.h"
 
 #include "tiles/feature/deserialize.h"
 #include "tiles/feature/serialize.h"
+#include "tiles/fixed/algo/bounding_box.h"
 #include "tiles/mvt/tile_spec.h"
 
 namespace tiles {
@@ -30,6 +36,39 @@ void quadtree_feature_packer::pack_features(
 
   packer_.finish_header(feature_count);
 
+  // the first quad tree holds all features with min_z <= root_.z_
+  // -> one span per (quad key, min_z) and an extra quad tree per min_z
+  std::vector<std::vector<quad_tree_input>> zoom_range_input(root_.z_ + 1);
+  auto const append_root_level = [&](std::vector<quadtree_feature>& features,
+                                     std::vector<quad_tree_input>& input) {
+    std::sort(begin(features), end(features),
+              [](auto const& a, auto const& b) {
+                return std::tie(a.quad_key_, a.feature_.zoom_levels_.first) <
+                       std::tie(b.quad_key_, b.feature_.zoom_levels_.first);
+              });
+    utl::equal_ranges_linear(
+        features,
+        [](auto const& a, auto const& b) { return a.quad_key_ == b.quad_key_; },
+        [&](auto const& lb, auto const& ub) {
+          std::optional<uint32_t> offset;
+          uint32_t span_count = 0;
+          utl::equal_ranges_linear(
+              lb, ub,
+              [](auto const& a, auto const& b) {
+                return a.feature_.zoom_levels_.first ==
+                       b.feature_.zoom_levels_.first;
+              },
+              [&](auto const& z_lb, auto const& z_ub) {
+                auto const span_offset = serialize_and_append_span(z_lb, z_ub);
+                zoom_range_input.at(z_lb->feature_.zoom_levels_.first)
+                    .push_back({z_lb->best_tile_, span_offset, 1U});
+                offset = offset.value_or(span_offset);
+                ++span_count;
+              });
+          input.push_back({lb->best_tile_, *offset, span_count});
+        });
+  };
+
   std::vector<std::string> quad_trees;
   for (auto& features : features_by_min_z) {
     if (features.empty()) {
@@ -38,13 +77,19 @@ void quadtree_feature_packer::pack_features(
     }
 
     std::vector<quad_tree_input> quad_tree_input;
-    utl::equal_ranges(
-        features,
-        [](auto const& a, auto const& b) { return a.quad_key_ < b.quad_key_; },
-        [&](auto const& lb, auto const& ub) {
-          quad_tree_input.push_back(
-              {lb->best_tile_, serialize_and_append_span(lb, ub), 1ULL});
-        });
+    if (quad_trees.empty()) {
+      append_root_level(features, quad_tree_input);
+    } else {
+      utl::equal_ranges(
+          features,
+          [](auto const& a, auto const& b) {
+            return a.quad_key_ < b.quad_key_;
+          },
+          [&](auto const& lb, auto const& ub) {
+            quad_tree_input.push_back(
+                {lb->best_tile_, serialize_and_append_span(lb, ub), 1ULL});
+          });
+    }
 
     quad_trees.emplace_back(make_quad_tree(root_, quad_tree_input));
   }
@@ -57,6 +102,19 @@ void quadtree_feature_packer::pack_features(
       packer_.append_packed(utl::to_vec(quad_trees, [&](auto const& quad_tree) {
         return quad_tree.empty() ? 0U : packer_.append(quad_tree);
       })));
+
+  // same layout: one quad tree per min_z in [0, root_.z_]
+  packer_.update_segment_offset(
+      kZoomRangeIndexId,
+      packer_.append_packed(utl::to_vec(zoom_range_input, [&](auto const& in) {
+        return in.empty() ? 0U : packer_.append(make_quad_tree(root_, in));
+      })));
+
+  packer_.append_feature_table();
+  packer_.append_feature_boxes();
+  if (index_ == pack_index::hilbert_rtree) {
+    packer_.append_hilbert_rtree();
+  }
 }
 
 geo::tile quadtree_feature_packer::find_best_tile(
@@ -110,7 +168,8 @@ uint32_t quadtree_feature_packer::serialize_and_append_span(
   uint32_t offset = packer_.buf_.size();
   for (auto it = begin; it != end; ++it) {
     packer_.append_feature(
-        serialize_feature(it->feature_, metadata_coder_, false));
+        serialize_feature(it->feature_, metadata_coder_, false),
+        it->feature_.zoom_levels_, bounding_box(it->feature_.geometry_));
   }
   packer_.append_span_end();
   return offset;
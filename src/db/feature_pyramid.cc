@@ -0,0 +1,235 @@
+#include "tiles/db/feature_pyramid.h"
+
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <set>
+#include <thread>
+#include <tuple>
+
+#include "geo/tile.h"
+
+#include "utl/equal_ranges_linear.h"
+#include "utl/erase_if.h"
+#include "utl/to_vec.h"
+#include "utl/verify.h"
+
+#include "tiles/constants.h"
+#include "tiles/db/feature_pack.h"
+#include "tiles/db/features_key_layout.h"
+#include "tiles/db/pack_compression.h"
+#include "tiles/db/pack_file.h"
+#include "tiles/db/shared_metadata.h"
+#include "tiles/feature/aggregate_line_features.h"
+#include "tiles/feature/aggregate_polygon_features.h"
+#include "tiles/feature/deserialize.h"
+#include "tiles/feature/feature.h"
+#include "tiles/feature/serialize.h"
+#include "tiles/fixed/algo/clip.h"
+#include "tiles/get_tile.h"
+#include "tiles/mvt/tile_spec.h"
+#include "tiles/util.h"
+
+namespace tiles {
+
+static_assert(kPyramidMaxZoomLvl <= kAggregatePolygonMaxZoomLevel);
+
+constexpr size_t kPyramidBatchSize = 4096;
+
+// at most one point per screen pixel (256px raster tile) and layer, the most
+// important one wins: most metadata, then lowest min zoom level, then id
+void thin_points(std::vector<feature>& points, uint32_t const z) {
+  std::sort(begin(points), end(points), [](auto const& a, auto const& b) {
+    return std::tuple{a.layer_, b.meta_.size(), a.zoom_levels_.first, a.id_} <
+           std::tuple{b.layer_, a.meta_.size(), b.zoom_levels_.first, b.id_};
+  });
+
+  // one tile unit (4096 extent) is 2^(20 - z), one pixel 2^4 tile units
+  auto const unit_shift = kMaxZoomLevel - z + kScreenPixelAreaLog2 / 2;
+  utl::equal_ranges_linear(
+      points,
+      [](auto const& a, auto const& b) { return a.layer_ == b.layer_; },
+      [&](auto lb, auto ub) {
+        std::set<std::pair<fixed_coord_t, fixed_coord_t>> units;
+        for (auto it = lb; it != ub; ++it) {
+          auto& multi_point = mpark::get<fixed_point>(it->geometry_);
+          utl::erase_if(multi_point, [&](auto const& p) {
+            return !units.emplace(p.x() >> unit_shift, p.y() >> unit_shift)
+                        .second;
+          });
+          if (multi_point.empty()) {
+            it->geometry_ = fixed_null{};
+          }
+        }
+      });
+
+  utl::erase_if(points, [](auto const& f) {
+    return mpark::holds_alternative<fixed_null>(f.geometry_);
+  });
+}
+
+// same steps as the tile builder with aggregation, but without the mvt encoding
+std::vector<feature> generalize_features(std::vector<feature> features,
+                                         geo::tile const& tile) {
+  auto const& box = tile_spec{tile}.draw_bounds_;
+
+  std::vector<feature> result;
+  std::map<size_t, std::vector<feature>> lines, polygons;  // by layer
+  for (auto& f : features) {
+    if (mpark::holds_alternative<fixed_polyline>(f.geometry_)) {
+      lines[f.layer_].emplace_back(std::move(f));  // clip after merge
+      continue;
+    }
+
+    f.geometry_ = clip(f.geometry_, box);
+    if (mpark::holds_alternative<fixed_polygon>(f.geometry_)) {
+      polygons[f.layer_].emplace_back(std::move(f));
+    } else if (mpark::holds_alternative<fixed_point>(f.geometry_)) {
+      result.emplace_back(std::move(f));
+    }
+  }
+
+  thin_points(result, tile.z_);
+
+  for (auto& [layer, layer_polygons] : polygons) {
+    auto aggregated =
+        aggregate_polygon_features(std::move(layer_polygons), tile.z_);
+    result.insert(end(result), std::make_move_iterator(begin(aggregated)),
+                  std::make_move_iterator(end(aggregated)));
+  }
+
+  for (auto& [layer, layer_lines] : lines) {
+    for (auto& f : aggregate_line_features(std::move(layer_lines), tile.z_)) {
+      f.geometry_ = clip(f.geometry_, box);
+      if (!mpark::holds_alternative<fixed_null>(f.geometry_)) {
+        result.emplace_back(std::move(f));
+      }
+    }
+  }
+
+  return result;
+}
+
+std::string make_pyramid_pack(geo::tile const& tile, lmdb::cursor& c,
+                              tile_key_layout const layout,
+                              pack_handle const& pack_handle,
+                              shared_metadata_decoder const& metadata_decoder,
+                              shared_metadata_coder const& metadata_coder) {
+  auto const spec = tile_spec{tile};
+
+  std::vector<feature> features;
+  pack_records_foreach(c, tile, layout, [&](auto const& db_tile, auto record) {
+    unpack_features(
+        db_tile, pack_handle.get(record).view(), tile, spec.draw_bounds_,
+        [&](auto const& feature_str) {
+          auto feature = deserialize_feature(
+              feature_str, metadata_decoder, spec.draw_bounds_, tile.z_, false,
+              home_bucket_hint{spec.insert_bounds_.min_corner(), db_tile});
+          if (feature) {
+            features.emplace_back(std::move(*feature));
+          }
+        });
+  });
+
+  features = generalize_features(std::move(features), tile);
+  if (features.empty()) {
+    return {};
+  }
+
+  return pack_features(
+      tile, metadata_coder,
+      {pack_features(utl::to_vec(features, [&](auto const& f) {
+        return serialize_feature(f, metadata_coder);
+      }))});
+}
+
+void build_feature_pyramid(tile_db_handle& db_handle, pack_handle& pack_handle,
+                           uint32_t const max_zoomlevel) {
+  utl::verify(max_zoomlevel <= kAggregatePolygonMaxZoomLevel,
+              "build_feature_pyramid: max zoomlevel too large {}",
+              max_zoomlevel);
+
+  auto layout = tile_key_layout::row_major;
+  auto codec = pack_codec::none;
+  std::optional<shared_metadata_decoder> metadata_decoder;
+  {
+    auto txn = db_handle.make_txn();
+    layout = get_features_key_layout(db_handle, txn);
+    if (auto const opt_codec =
+            txn.get(db_handle.meta_dbi(txn), kMetaKeyPackCodec);
+        opt_codec) {
+      codec = parse_pack_codec(*opt_codec);  // same as the feature packs
+    }
+    metadata_decoder = make_shared_metadata_decoder(db_handle, txn);
+    clear_feature_pyramid(db_handle, txn);
+    txn.commit();
+  }
+  auto const metadata_coder = make_shared_metadata_coder(db_handle);
+
+  for (auto z = 0U; z <= max_zoomlevel; ++z) {
+    scoped_timer t{fmt::format("build feature pyramid z{}", z)};
+
+    std::vector<geo::tile> tiles;
+    for (auto const& tile : geo::make_tile_range(z)) {
+      tiles.push_back(tile);
+    }
+
+    // render batches in parallel, append sequentially: the pack file must
+    // not grow (remap) while features are read from it
+    size_t pack_count = 0;
+    size_t pack_bytes = 0;
+    for (size_t offset = 0; offset < tiles.size();
+         offset += kPyramidBatchSize) {
+      auto const batch_size =
+          std::min(kPyramidBatchSize, tiles.size() - offset);
+      std::vector<std::string> packs(batch_size);
+
+      std::atomic_size_t next{0};
+      std::vector<std::thread> threads;
+      threads.reserve(std::thread::hardware_concurrency());
+      for (auto i = 0U; i < std::thread::hardware_concurrency(); ++i) {
+        threads.emplace_back([&] {
+          auto txn = lmdb::txn{db_handle.env_, lmdb::txn_flags::RDONLY};
+          auto feature_dbi = db_handle.features_dbi(txn);
+          auto c = lmdb::cursor{txn, feature_dbi};
+
+          for (auto idx = next++; idx < batch_size; idx = next++) {
+            auto& pack = packs[idx];
+            pack = make_pyramid_pack(tiles[offset + idx], c, layout,
+                                     pack_handle, *metadata_decoder,
+                                     metadata_coder);
+            if (!pack.empty() && codec != pack_codec::none) {
+              pack = compress_pack(pack, pack_handle.dictionary_);
+            }
+          }
+        });
+      }
+      std::for_each(begin(threads), end(threads), [](auto& t) { t.join(); });
+
+      auto txn = db_handle.make_txn();
+      auto pyramid_dbi = db_handle.pyramid_dbi(txn);
+      for (auto i = 0ULL; i < batch_size; ++i) {
+        if (packs[i].empty()) {
+          continue;
+        }
+
+        auto const record = pack_handle.append(packs[i]);
+        txn.put(pyramid_dbi, tile_to_key(tiles[offset + i]),
+                pack_records_serialize(record));
+        ++pack_count;
+        pack_bytes += packs[i].size();
+      }
+      txn.commit();
+    }
+
+    t_log("pyramid z{}: {} packs with {}", z, printable_num{pack_count},
+          printable_bytes{pack_bytes});
+  }
+
+  auto txn = db_handle.make_txn();
+  txn.put(db_handle.meta_dbi(txn), kMetaKeyPyramidMaxZoomLevel,
+          std::to_string(max_zoomlevel));
+  txn.commit();
+}
+
+}  // namespace tiles
@@ -0,0 +1,118 @@
+#include "tiles/db/hilbert_rtree.h"
+
+#include <array>
+#include <limits>
+
+namespace tiles {
+
+constexpr uint32_t kHilbertBits = 16;
+
+// position on the hilbert curve of order 16 (see wikipedia: xy2d)
+uint64_t hilbert_value(uint32_t x, uint32_t y) {
+  constexpr uint32_t n = 1U << kHilbertBits;
+  uint64_t d = 0;
+  for (auto s = n / 2; s > 0; s /= 2) {
+    uint32_t const rx = (x & s) != 0 ? 1 : 0;
+    uint32_t const ry = (y & s) != 0 ? 1 : 0;
+    d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+std::string make_hilbert_rtree(std::vector<hilbert_rtree_input> input) {
+  using item = std::array<uint32_t, kHilbertRTreeItemSize>;
+
+  std::string buf;
+  append<uint32_t>(buf, static_cast<uint32_t>(input.size()));
+  if (input.empty()) {
+    return buf;
+  }
+
+  auto const center = [](fixed_box const& b, auto const& get) {
+    return (static_cast<uint64_t>(hilbert_rtree_coord(get(b.min_corner()))) +
+            hilbert_rtree_coord(get(b.max_corner()))) /
+           2;
+  };
+  auto const get_x = [](auto const& p) { return p.x(); };
+  auto const get_y = [](auto const& p) { return p.y(); };
+
+  // centers -> 16 bit grid over the extent of all entries
+  uint64_t min_x = std::numeric_limits<uint64_t>::max(), min_y = min_x;
+  uint64_t max_x = 0, max_y = 0;
+  for (auto const& e : input) {
+    min_x = std::min(min_x, center(e.box_, get_x));
+    min_y = std::min(min_y, center(e.box_, get_y));
+    max_x = std::max(max_x, center(e.box_, get_x));
+    max_y = std::max(max_y, center(e.box_, get_y));
+  }
+  auto const scale = [](uint64_t const v, uint64_t const min,
+                        uint64_t const max) {
+    return max == min ? 0U
+                      : static_cast<uint32_t>((v - min) *
+                                              ((1U << kHilbertBits) - 1) /
+                                              (max - min));
+  };
+
+  std::vector<std::pair<uint64_t, item>> leaves;
+  leaves.reserve(input.size());
+  for (auto const& e : input) {
+    leaves.emplace_back(
+        hilbert_value(scale(center(e.box_, get_x), min_x, max_x),
+                      scale(center(e.box_, get_y), min_y, max_y)),
+        item{hilbert_rtree_coord(e.box_.min_corner().x()),
+             hilbert_rtree_coord(e.box_.min_corner().y()),
+             hilbert_rtree_coord(e.box_.max_corner().x()),
+             hilbert_rtree_coord(e.box_.max_corner().y()),
+             std::min(e.zoom_levels_.first, 0xFFU) |
+                 (std::min(e.zoom_levels_.second, 0xFFU) << 8),
+             e.payload_});
+  }
+  std::sort(begin(leaves), end(leaves));
+
+  std::vector<item> items;
+  items.reserve(leaves.size());
+  for (auto const& [value, leaf] : leaves) {
+    items.push_back(leaf);
+  }
+
+  size_t level_begin = 0;
+  size_t level_end = items.size();
+  while (level_end - level_begin > 1) {
+    for (auto i = level_begin; i < level_end; i += kHilbertRTreeNodeSize) {
+      item node{std::numeric_limits<uint32_t>::max(),
+                std::numeric_limits<uint32_t>::max(),
+                0U,
+                0U,
+                0xFFU,
+                static_cast<uint32_t>(i)};
+      for (auto j = i; j < std::min(i + kHilbertRTreeNodeSize, level_end);
+           ++j) {
+        node[0] = std::min(node[0], items[j][0]);
+        node[1] = std::min(node[1], items[j][1]);
+        node[2] = std::max(node[2], items[j][2]);
+        node[3] = std::max(node[3], items[j][3]);
+        node[4] = std::min(node[4] & 0xFFU, items[j][4] & 0xFFU) |
+                  (std::max(node[4] >> 8, items[j][4] >> 8) << 8);
+      }
+      items.push_back(node);
+    }
+    level_begin = level_end;
+    level_end = items.size();
+  }
+
+  for (auto const& i : items) {
+    for (auto const v : i) {
+      append<uint32_t>(buf, v);
+    }
+  }
+  return buf;
+}
+
+}  // namespace tiles
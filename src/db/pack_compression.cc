@@ -0,0 +1,217 @@
+#include "tiles/db/pack_compression.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "zlib.h"
+
+#include "utl/verify.h"
+
+#include "tiles/bin_utils.h"
+#include "tiles/db/feature_pack.h"
+#include "tiles/db/pack_file.h"
+#include "tiles/db/tile_database.h"
+#include "tiles/util.h"
+
+namespace tiles {
+
+constexpr auto const kPackCodecNone = "none";
+constexpr auto const kPackCodecDeflate = "deflate";
+constexpr auto const kPackCodecDeflateDict = "deflate-dict";
+
+constexpr size_t kPackDictionaryMaxSize = 32 * 1024;  // zlib window
+constexpr size_t kPackDictionaryGramSize = 8;
+constexpr size_t kPackDictionaryMaxSampleSize = 4 * 1024 * 1024;
+
+char const* to_str(pack_codec const codec) {
+  switch (codec) {
+    case pack_codec::none: return kPackCodecNone;
+    case pack_codec::deflate: return kPackCodecDeflate;
+    case pack_codec::deflate_dict: return kPackCodecDeflateDict;
+    default: throw utl::fail("to_str: unknown pack_codec");
+  }
+}
+
+pack_codec parse_pack_codec(std::string_view const str) {
+  for (auto const codec :
+       {pack_codec::none, pack_codec::deflate, pack_codec::deflate_dict}) {
+    if (str == to_str(codec)) {
+      return codec;
+    }
+  }
+  throw utl::fail("parse_pack_codec: unknown codec {}", str);
+}
+
+struct pack_deflater {
+  pack_deflater() {
+    utl::verify(deflateInit(&stream_, kCompressLevelMax) == Z_OK,
+                "pack_deflater: init failed");
+  }
+  ~pack_deflater() { deflateEnd(&stream_); }
+
+  pack_deflater(pack_deflater const&) = delete;
+  pack_deflater(pack_deflater&&) = delete;
+  pack_deflater& operator=(pack_deflater const&) = delete;
+  pack_deflater& operator=(pack_deflater&&) = delete;
+
+  std::string compress(std::string const& input,
+                       std::string const& dictionary) {
+    utl::verify(deflateReset(&stream_) == Z_OK, "pack_deflater: reset failed");
+    if (!dictionary.empty()) {
+      utl::verify(
+          deflateSetDictionary(
+              &stream_, reinterpret_cast<Bytef const*>(dictionary.data()),
+              static_cast<uInt>(dictionary.size())) == Z_OK,
+          "pack_deflater: set dictionary failed");
+    }
+
+    std::string buffer(deflateBound(&stream_, input.size()), '\0');
+    stream_.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));  // NOLINT
+    stream_.avail_in = static_cast<uInt>(input.size());
+    stream_.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+    stream_.avail_out = static_cast<uInt>(buffer.size());
+
+    utl::verify(deflate(&stream_, Z_FINISH) == Z_STREAM_END,
+                "pack_deflater: deflate failed");
+
+    buffer.resize(stream_.total_out);
+    return buffer;
+  }
+
+  z_stream stream_{};
+};
+
+struct pack_inflater {
+  pack_inflater() {
+    utl::verify(inflateInit(&stream_) == Z_OK, "pack_inflater: init failed");
+  }
+  ~pack_inflater() { inflateEnd(&stream_); }
+
+  pack_inflater(pack_inflater const&) = delete;
+  pack_inflater(pack_inflater&&) = delete;
+  pack_inflater& operator=(pack_inflater const&) = delete;
+  pack_inflater& operator=(pack_inflater&&) = delete;
+
+  void decompress(std::string_view const input, std::string& output,
+                  std::string const& dictionary) {
+    utl::verify(inflateReset(&stream_) == Z_OK, "pack_inflater: reset failed");
+    stream_.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));  // NOLINT
+    stream_.avail_in = static_cast<uInt>(input.size());
+    stream_.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream_.avail_out = static_cast<uInt>(output.size());
+
+    auto result = inflate(&stream_, Z_FINISH);
+    if (result == Z_NEED_DICT) {
+      utl::verify(!dictionary.empty(), "pack_inflater: dictionary missing");
+      utl::verify(
+          inflateSetDictionary(
+              &stream_, reinterpret_cast<Bytef const*>(dictionary.data()),
+              static_cast<uInt>(dictionary.size())) == Z_OK,
+          "pack_inflater: wrong dictionary");
+      result = inflate(&stream_, Z_FINISH);
+    }
+
+    utl::verify(result == Z_STREAM_END && stream_.total_out == output.size(),
+                "pack_inflater: inflate failed");
+  }
+
+  z_stream stream_{};
+};
+
+std::string compress_pack(std::string const& pack,
+                          std::string const& dictionary) {
+  thread_local pack_deflater deflater;
+  auto const compressed = deflater.compress(pack, dictionary);
+
+  feature_packer packer;
+  packer.register_segment(kCompressedPackId);
+  packer.finish_header(0);
+  packer.update_segment_offset(kCompressedPackId,
+                               static_cast<uint32_t>(packer.buf_.size()));
+  append<uint8_t>(packer.buf_,
+                  static_cast<uint8_t>(dictionary.empty()
+                                           ? pack_codec::deflate
+                                           : pack_codec::deflate_dict));
+  append<uint32_t>(packer.buf_, static_cast<uint32_t>(pack.size()));
+  packer.buf_.append(compressed);
+  packer.finish();
+
+  return packer.buf_.size() < pack.size() ? packer.buf_ : pack;
+}
+
+std::string_view decompress_pack(std::string_view const pack,
+                                 std::string& buf,
+                                 std::string const& dictionary) {
+  if (pack.size() < 5 ||
+      pack.size() < (read_nth<uint8_t>(pack.data(), 4) + 1ULL) * 5) {
+    return pack;  // no (valid) header
+  }
+
+  auto const offset = find_segment_offset(pack, kCompressedPackId);
+  if (!offset) {
+    return pack;
+  }
+
+  constexpr auto const kFrameSize = sizeof(uint8_t) + sizeof(uint32_t);
+  utl::verify(*offset + kFrameSize + sizeof(uint32_t) <= pack.size(),
+              "decompress_pack: invalid segment offset");
+  auto const codec =
+      static_cast<pack_codec>(read<uint8_t>(pack.data(), *offset));
+  utl::verify(codec == pack_codec::deflate || codec == pack_codec::deflate_dict,
+              "decompress_pack: unknown codec {}", static_cast<int>(codec));
+
+  thread_local pack_inflater inflater;
+  buf.resize(read<uint32_t>(pack.data(), *offset + sizeof(uint8_t)));
+  inflater.decompress(
+      pack.substr(*offset + kFrameSize,
+                  pack.size() - *offset - kFrameSize - sizeof(uint32_t)),
+      buf, dictionary);
+  return buf;
+}
+
+std::string train_pack_dictionary(std::vector<std::string> const& samples) {
+  std::unordered_map<std::string_view, size_t> counts;
+  size_t sample_size = 0;
+  for (auto const& sample : samples) {
+    if (sample_size > kPackDictionaryMaxSampleSize) {
+      break;
+    }
+    sample_size += sample.size();
+
+    std::string_view const sv{sample};
+    for (size_t i = 0; i + kPackDictionaryGramSize <= sv.size(); ++i) {
+      ++counts[sv.substr(i, kPackDictionaryGramSize)];
+    }
+  }
+
+  std::vector<std::pair<size_t, std::string_view>> grams;
+  for (auto const& [gram, count] : counts) {
+    if (count > 1) {
+      grams.emplace_back(count, gram);
+    }
+  }
+  std::sort(begin(grams), end(grams), std::greater<>());
+  grams.resize(std::min(grams.size(),
+                        kPackDictionaryMaxSize / kPackDictionaryGramSize));
+
+  // zlib: most frequent substrings at the end of the dictionary
+  std::string dictionary;
+  dictionary.reserve(grams.size() * kPackDictionaryGramSize);
+  for (auto it = grams.rbegin(); it != grams.rend(); ++it) {
+    dictionary.append(it->second);
+  }
+  return dictionary;
+}
+
+void load_pack_dictionary(tile_db_handle& db_handle, pack_handle& pack_handle) {
+  auto txn = db_handle.make_txn();
+  auto meta_dbi = db_handle.meta_dbi(txn);
+  auto const opt_dictionary = txn.get(meta_dbi, kMetaKeyPackDictionary);
+  pack_handle.dictionary_ =
+      opt_dictionary ? std::string{*opt_dictionary} : std::string{};
+}
+
+}  // namespace tiles
@@ -1,5 +1,6 @@
 #include "tiles/db/prepare_tiles.h"
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <numeric>
@@ -7,12 +8,14 @@
 
 #include "geo/tile.h"
 
+#include "tiles/db/features_key_layout.h"
 #include "tiles/db/pack_file.h"
 #include "tiles/db/tile_database.h"
 #include "tiles/db/tile_index.h"
 #include "tiles/get_tile.h"
 #include "tiles/perf_counter.h"
 #include "tiles/util.h"
+#include "tiles/util_parallel.h"
 
 namespace tiles {
 
@@ -111,15 +114,18 @@ prepare_manager make_prepare_manager(tile_db_handle& db_handle,
   auto maxy = std::numeric_limits<uint32_t>::min();
 
   auto txn = db_handle.make_txn();
+  auto const layout = get_features_key_layout(db_handle, txn);
   auto feature_dbi = db_handle.features_dbi(txn);
   auto c = lmdb::cursor{txn, feature_dbi};
   for (auto el = c.get<tile_key_t>(lmdb::cursor_op::FIRST); el;
        el = c.get<tile_key_t>(lmdb::cursor_op::NEXT)) {
-    auto const tile = key_to_tile(el->first);
-    minx = std::min(minx, tile.x_);
-    miny = std::min(miny, tile.y_);
-    maxx = std::max(maxx, tile.x_);
-    maxy = std::max(maxy, tile.y_);
+    // buckets of the coarser index levels -> their z10 descendants
+    auto const tile = key_to_tile(el->first, layout);
+    auto const d = kTileDefaultIndexZoomLvl - tile.z_;
+    minx = std::min(minx, tile.x_ << d);
+    miny = std::min(miny, tile.y_ << d);
+    maxx = std::max(maxx, ((tile.x_ + 1) << d) - 1);
+    maxy = std::max(maxy, ((tile.y_ + 1) << d) - 1);
   }
 
   utl::verify(minx != std::numeric_limits<uint32_t>::max() &&
@@ -132,15 +138,32 @@ prepare_manager make_prepare_manager(tile_db_handle& db_handle,
 }
 
 void prepare_tiles(tile_db_handle& db_handle, pack_handle& pack_handle,
-                   uint32_t max_zoomlevel) {
+                   uint32_t max_zoomlevel,
+                   std::vector<uint32_t> const& tile_extents) {
+  verify_tile_extents(tile_extents);
   auto m = make_prepare_manager(db_handle, max_zoomlevel);
 
   auto render_ctx = make_render_ctx(db_handle);
+  render_ctx.tb_tile_extents_ = tile_extents;
   render_ctx.ignore_fully_seaside_ = true;
   render_ctx.tb_aggregate_lines_ = true;
   render_ctx.tb_aggregate_polygons_ = true;
+  render_ctx.compress_level_ = kCompressLevelMax;  // once -> best ratio
   null_perf_counter npc;
 
+  // expensive low-z tiles: spread their layers over all threads
+  // (the prepare threads process the queue between their own tiles)
+  queue_wrapper<std::function<void()>> layer_queue;
+  render_ctx.tb_layer_queue_ = &layer_queue;
+  auto const process_layer_task = [&](bool const wait) {
+    std::function<void()> fn;
+    if (wait ? layer_queue.dequeue(fn) : layer_queue.try_dequeue(fn)) {
+      fn();
+      layer_queue.finish();
+    }
+  };
+
+  std::atomic_size_t active_threads{std::thread::hardware_concurrency()};
   std::vector<std::thread> threads;
   threads.reserve(std::thread::hardware_concurrency());
   for (auto i = 0U; i < std::thread::hardware_concurrency(); ++i) {
@@ -148,6 +171,10 @@ void prepare_tiles(tile_db_handle& db_handle, pack_handle& pack_handle,
       while (true) {
         auto batch = m.get_batch();
         if (batch.empty()) {
+          --active_threads;
+          while (active_threads != 0) {
+            process_layer_task(true);  // help the remaining tiles
+          }
           break;
         }
 
@@ -157,13 +184,21 @@ void prepare_tiles(tile_db_handle& db_handle, pack_handle& pack_handle,
           auto c = lmdb::cursor{txn, feature_dbi};
 
           for (auto& task : batch) {
-            pack_records_foreach(c, task.tile_, [&](auto t, auto r) {
+            auto const add_pack = [&](auto t, auto r) {
               task.packs_.emplace_back(t, r);
-            });
+            };
+            if (use_pyramid(render_ctx, task.tile_)) {
+              pyramid_records_foreach(db_handle, txn, task.tile_, add_pack);
+            } else {
+              pack_records_foreach(c, task.tile_,
+                                   render_ctx.features_key_layout_, add_pack);
+            }
           }
         }
 
         for (auto& task : batch) {
+          process_layer_task(false);
+
           using namespace std::chrono;
           auto start = steady_clock::now();
           task.result_ = get_tile(
@@ -171,7 +206,7 @@ void prepare_tiles(tile_db_handle& db_handle, pack_handle& pack_handle,
               [&](auto&& fn) {
                 std::for_each(begin(task.packs_), end(task.packs_),
                               [&](auto const& p) {
-                                fn(p.first, pack_handle.get(p.second));
+                                fn(p.first, pack_handle.get(p.second).view());
                               });
               },
               npc);
@@ -205,6 +240,8 @@ void prepare_tiles(tile_db_handle& db_handle, pack_handle& pack_handle,
   auto meta_dbi = db_handle.meta_dbi(txn);
   txn.put(meta_dbi, kMetaKeyMaxPreparedZoomLevel,
           std::to_string(max_zoomlevel));
+  txn.put(meta_dbi, kMetaKeyPreparedTileFraming, kPreparedTileFraming);
+  txn.put(meta_dbi, kMetaKeyTileExtents, write_tile_extents(tile_extents));
   txn.commit();
 }
 
@@ -1,10 +1,11 @@
 #include "tiles/feature/aggregate_line_features.h"
 
-#include <stack>
+#include <functional>
+#include <limits>
+#include <unordered_map>
 
 #include "utl/concat.h"
 #include "utl/equal_ranges_linear.h"
-#include "utl/erase_duplicates.h"
 #include "utl/erase_if.h"
 #include "utl/to_vec.h"
 #include "utl/verify.h"
@@ -16,77 +17,100 @@
 
 namespace tiles {
 
-struct line;
-using line_handle = std::unique_ptr<line>;
+constexpr auto const kInvalidLineIdx = std::numeric_limits<uint32_t>::max();
 
 struct line {
   fixed_xy from_{}, to_{};
 
-  line_handle left_, right_;
+  uint32_t left_{kInvalidLineIdx}, right_{kInvalidLineIdx};
   feature* feature_{nullptr};
   uint32_t geo_idx_{std::numeric_limits<uint32_t>::max()};
 
-  bool reversed_{false};
+  bool flip_{false};  // reverses the whole subtree (see aggregate_geometry)
   bool oneway_{false};
 };
 
+struct fixed_xy_hash {
+  size_t operator()(fixed_xy const& pos) const {
+    auto h = std::hash<fixed_coord_t>{}(pos.x());
+    h ^= std::hash<fixed_coord_t>{}(pos.y()) + 0x9e3779b9 + (h << 6U) +
+         (h >> 2U);
+    return h;
+  }
+};
+
+struct line_graph {
+  // all lines (leafs) and join results (inner nodes) in one arena
+  std::vector<line> lines_;
+
+  // root line of every initial line (kInvalidLineIdx: joined away)
+  std::vector<uint32_t> slots_;
+};
+
 template <typename FeatureIt>
-std::vector<line_handle> make_line_handles(FeatureIt lb, FeatureIt ub) {
-  std::vector<line_handle> lines;
+line_graph make_line_graph(FeatureIt lb, FeatureIt ub) {
+  line_graph g;
   for (auto it = lb; it != ub; ++it) {
     auto const& l = mpark::get<fixed_polyline>(it->geometry_);
     utl::verify(l.size() < std::numeric_limits<uint32_t>::max(),
-                "make_line_handles: too many features");
+                "make_line_graph: too many features");
 
     for (auto i = 0ULL; i < l.size(); ++i) {
-      lines.emplace_back(std::make_unique<line>());
-      lines.back()->from_ = l[i].front();
-      lines.back()->to_ = l[i].back();
-      lines.back()->feature_ = &*it;
-      lines.back()->geo_idx_ = i;
+      g.slots_.push_back(static_cast<uint32_t>(g.lines_.size()));
+
+      auto& line = g.lines_.emplace_back();
+      line.from_ = l[i].front();
+      line.to_ = l[i].back();
+      line.feature_ = &*it;
+      line.geo_idx_ = i;
       // TODO oneway support (needs special tag?!)
     }
   }
-  return lines;
+  utl::verify(g.lines_.size() < kInvalidLineIdx / 2,
+              "make_line_graph: too many lines");
+  return g;
 }
 
-void join_lines(std::vector<line_handle>& handles) {
-  std::vector<std::pair<fixed_xy, line_handle*>> idx;
-  for (auto& lh : handles) {
-    idx.emplace_back(lh->from_, &lh);
-    idx.emplace_back(lh->to_, &lh);
+void join_lines(line_graph& g) {
+  auto& lines = g.lines_;
+  auto& slots = g.slots_;
+  lines.reserve(lines.size() * 2);  // upper bound: one join per line
+
+  // endpoint index: linked list of slots per position (descending slot idx)
+  std::vector<std::pair<uint32_t, uint32_t>> entries;  // slot, next entry
+  std::unordered_map<fixed_xy, uint32_t, fixed_xy_hash> heads;
+  heads.reserve(slots.size() * 2);
+  for (auto slot = 0U; slot < slots.size(); ++slot) {
+    auto const& l = lines[slots[slot]];
+    for (auto const& pos : {l.from_, l.to_}) {
+      auto [it, inserted] = heads.emplace(pos, kInvalidLineIdx);
+      if (!inserted && entries[it->second].first == slot) {
+        continue;  // from == to
+      }
+      entries.emplace_back(slot, it->second);
+      it->second = static_cast<uint32_t>(entries.size() - 1);
+    }
   }
-  utl::erase_duplicates(
-      idx,
-      [](auto const& a, auto const& b) {
-        return std::tie(a.first.x(), a.first.y(), a.second) <
-               std::tie(b.first.x(), b.first.y(), b.second);
-      },
-      [](auto const& a, auto const& b) {
-        return std::tie(a.first.x(), a.first.y(), a.second) ==
-               std::tie(b.first.x(), b.first.y(), b.second);
-      });
 
-  auto const find_incident_line = [&](line_handle const& lh,
-                                      fixed_xy const& pos) -> line_handle* {
+  auto const find_incident_slot = [&](uint32_t const self,
+                                      fixed_xy const& pos) -> uint32_t {
     if (pos == invalid_xy) {
-      return nullptr;
+      return kInvalidLineIdx;
     }
 
-    auto it0 = std::lower_bound(
-        begin(idx), end(idx), pos, [](auto const& a, auto const& b) {
-          return std::tie(a.first.x(), a.first.y()) < std::tie(b.x(), b.y());
-        });
+    auto const head = heads.at(pos);
 
     size_t count = 0;
-    line_handle* other = nullptr;
-    for (auto it = it0; it != end(idx) && it->first == pos; ++it) {
+    auto other = kInvalidLineIdx;
+    for (auto e = head; e != kInvalidLineIdx; e = entries[e].second) {
       ++count;
-      // NOLINTNEXTLINE
-      if (it->second->get() == lh.get() || it->second->get() == nullptr) {
+      auto const slot = entries[e].first;
+      if (slot == self || slots[slot] == kInvalidLineIdx) {
         continue;  // found self or already gone
       }
-      other = it->second;
+      if (other == kInvalidLineIdx) {
+        other = slot;  // largest slot idx wins (as in sorted order)
+      }
     }
 
     if (count == 2) {
@@ -94,138 +118,134 @@ void join_lines(std::vector<line_handle>& handles) {
     }
 
     // degree != 2 -> "burn" this coordinate for further processing
-    for (auto it = it0; it != end(idx) && it->first == pos; ++it) {
-      // NOLINTNEXTLINE
-      if (it->second->get() == nullptr) {
+    for (auto e = head; e != kInvalidLineIdx; e = entries[e].second) {
+      auto const root = slots[entries[e].first];
+      if (root == kInvalidLineIdx) {
         continue;  // self can already be gone in bwd pass
       }
 
-      if ((**it->second).from_ == pos) {
-        (**it->second).from_ = invalid_xy;
+      if (lines[root].from_ == pos) {
+        lines[root].from_ = invalid_xy;
       }
-      if ((**it->second).to_ == pos) {
-        (**it->second).to_ = invalid_xy;
+      if (lines[root].to_ == pos) {
+        lines[root].to_ = invalid_xy;
       }
     }
 
-    return nullptr;
+    return kInvalidLineIdx;
   };
 
-  auto const mark_reversed = [](line* l) {
-    std::stack<line*> stack{{l}};
-    while (!stack.empty()) {
-      auto* curr = stack.top();
-      stack.pop();
-
-      curr->reversed_ = !curr->reversed_;
-
-      if (curr->left_) {
-        stack.push(curr->left_.get());
-      }
-      if (curr->right_) {
-        stack.push(curr->right_.get());
-      }
+  auto const join = [&](uint32_t const slot, uint32_t const other_slot,
+                        bool const forward) {
+    auto const curr = slots[slot];
+    auto const other = slots[other_slot];
+
+    line joined;
+    joined.oneway_ = lines[curr].oneway_;
+    if (forward) {
+      joined.from_ = lines[curr].from_;
+      joined.left_ = curr;
+      joined.right_ = other;
+    } else {
+      joined.to_ = lines[curr].to_;
+      joined.left_ = other;
+      joined.right_ = curr;
     }
+
+    slots[other_slot] = kInvalidLineIdx;
+    slots[slot] = static_cast<uint32_t>(lines.size());
+    return &lines.emplace_back(joined);
   };
 
-  for (auto it = begin(handles); it != end(handles); ++it) {
-    if (!*it || (**it).from_ == (**it).to_) {
+  for (auto slot = 0U; slot < slots.size(); ++slot) {
+    if (slots[slot] == kInvalidLineIdx ||
+        lines[slots[slot]].from_ == lines[slots[slot]].to_) {
       continue;
     }
 
-    line_handle* other = nullptr;
-    while ((other = find_incident_line(*it, (**it).from_)) != nullptr) {
-      if (*other == nullptr) {
-        break;  // other alreay moved if join already discarded
-      }
-      if ((**it).oneway_ != (**other).oneway_) {
+    auto other_slot = kInvalidLineIdx;
+    while ((other_slot = find_incident_slot(
+                slot, lines[slots[slot]].from_)) != kInvalidLineIdx) {
+      auto& curr = lines[slots[slot]];
+      auto& other = lines[slots[other_slot]];
+      if (curr.oneway_ != other.oneway_) {
         break;  // dont join oneway with twoway
       }
-      if ((**other).from_ == (**other).to_) {
+      if (other.from_ == other.to_) {
         break;  // other is a "blossom"
       }
 
-      auto joined = std::make_unique<line>();
-      joined->to_ = (**it).to_;
-      joined->oneway_ = (**it).oneway_;
-
-      if ((**it).from_ == (**other).to_) {  //  --(other)--> X --(this)-->
-        joined->from_ = (**other).from_;
+      if (curr.from_ == other.to_) {  //  --(other)--> X --(this)-->
+        auto const from = other.from_;
+        join(slot, other_slot, false)->from_ = from;
       } else {  //  <--(other)-- X --(this)-->
-        if ((**it).oneway_) {
+        if (curr.oneway_) {
           break;  // dont join conflicting oneway directions
         }
-        joined->from_ = (**other).to_;
-        mark_reversed(other->get());
+        other.flip_ = !other.flip_;
+        auto const from = other.to_;
+        join(slot, other_slot, false)->from_ = from;
       }
-
-      joined->left_ = std::move(*other);
-      joined->right_ = std::move(*it);
-      *it = std::move(joined);
     }
 
-    if ((**it).from_ == (**it).to_) {
+    if (lines[slots[slot]].from_ == lines[slots[slot]].to_) {
       continue;  // cycle detected
     }
 
-    while ((other = find_incident_line(*it, (**it).to_)) != nullptr) {
-      if (*other == nullptr) {
-        break;  // other alreay moved if join already discarded
-      }
-      if ((**it).oneway_ != (**other).oneway_) {
+    while ((other_slot = find_incident_slot(
+                slot, lines[slots[slot]].to_)) != kInvalidLineIdx) {
+      auto& curr = lines[slots[slot]];
+      auto& other = lines[slots[other_slot]];
+      if (curr.oneway_ != other.oneway_) {
         break;  // dont join oneway with twoway
       }
-      if ((**other).from_ == (**other).to_) {
+      if (other.from_ == other.to_) {
         break;  // other is a "blossom"
       }
 
-      auto joined = std::make_unique<line>();
-      joined->from_ = (**it).from_;
-      joined->oneway_ = (**it).oneway_;
-
-      if ((**it).to_ == (**other).from_) {  // --(this)--> X --(other)-->
-        joined->to_ = (**other).to_;
+      if (curr.to_ == other.from_) {  // --(this)--> X --(other)-->
+        auto const to = other.to_;
+        join(slot, other_slot, true)->to_ = to;
       } else {  // --(this)--> X <--(other)--
-        if ((**it).oneway_) {
+        if (curr.oneway_) {
           break;  // conflicting oneway directions
         }
-        joined->to_ = (**other).from_;
-        mark_reversed(other->get());
+        other.flip_ = !other.flip_;
+        auto const to = other.from_;
+        join(slot, other_slot, true)->to_ = to;
       }
-
-      joined->left_ = std::move(*it);
-      joined->right_ = std::move(*other);
-      *it = std::move(joined);
     }
   }
 }
 
-fixed_polyline aggregate_geometry(std::vector<line_handle> lines) {
+fixed_polyline aggregate_geometry(line_graph& g) {
   fixed_polyline polyline;
 
-  for (auto& line : lines) {
-    if (!line) {  // joined away
+  std::vector<std::pair<uint32_t, bool>> stack;  // line idx, reversed
+  for (auto const root : g.slots_) {
+    if (root == kInvalidLineIdx) {  // joined away
       continue;
-    } else if (line->feature_ != nullptr) {  // unjoined / single
-      polyline.emplace_back(
-          std::move(mpark::get<fixed_polyline>(line->feature_->geometry_)
-                        .at(line->geo_idx_)));
+    } else if (g.lines_[root].feature_ != nullptr) {  // unjoined / single
+      auto const& l = g.lines_[root];
+      polyline.emplace_back(std::move(
+          mpark::get<fixed_polyline>(l.feature_->geometry_).at(l.geo_idx_)));
     } else {  // join result;
       fixed_line joined_geo;
 
-      std::stack<line_handle> stack;
-      stack.emplace(std::move(line));
+      stack.emplace_back(root, false);
       while (!stack.empty()) {
-        auto curr = std::move(stack.top());
-        stack.pop();
+        auto const [idx, parent_reversed] = stack.back();
+        stack.pop_back();
 
-        if (curr->feature_ != nullptr) {
+        auto const& curr = g.lines_[idx];
+        auto const reversed = parent_reversed != curr.flip_;
+        if (curr.feature_ != nullptr) {
           auto const skip = joined_geo.empty() ? 0 : 1;
           auto const& curr_geo =
-              mpark::get<fixed_polyline>(curr->feature_->geometry_)
-                  .at(curr->geo_idx_);
+              mpark::get<fixed_polyline>(curr.feature_->geometry_)
+                  .at(curr.geo_idx_);
 
-          if (curr->reversed_) {
+          if (reversed) {
             std::reverse_copy(begin(curr_geo), std::next(end(curr_geo), -skip),
                               std::back_inserter(joined_geo));
           } else {
@@ -233,12 +253,12 @@ fixed_polyline aggregate_geometry(std::vector<line_handle> lines) {
                       std::back_inserter(joined_geo));
           }
         } else {
-          if (curr->reversed_) {
-            stack.emplace(std::move(curr->left_));
-            stack.emplace(std::move(curr->right_));
+          if (reversed) {
+            stack.emplace_back(curr.left_, reversed);
+            stack.emplace_back(curr.right_, reversed);
           } else {
-            stack.emplace(std::move(curr->right_));
-            stack.emplace(std::move(curr->left_));
+            stack.emplace_back(curr.right_, reversed);
+            stack.emplace_back(curr.left_, reversed);
           }
         }
       }
@@ -261,14 +281,15 @@ std::vector<feature> aggregate_line_features(std::vector<feature> features,
       features,
       [](auto const& lhs, auto const& rhs) { return lhs.meta_ == rhs.meta_; },
       [&](auto lb, auto ub) {
-        auto lines = make_line_handles(lb, ub);
-        join_lines(lines);
+        auto graph = make_line_graph(lb, ub);
+        join_lines(graph);
 
         feature f;
         f.id_ = lb->id_;
         f.meta_ = std::move(lb->meta_);
+        f.shared_meta_ids_ = std::move(lb->shared_meta_ids_);
 
-        f.geometry_ = aggregate_geometry(std::move(lines));
+        f.geometry_ = aggregate_geometry(graph);
         if (z <= kMaxZoomLevel) {
           f.geometry_ =
               simplify(std::move(f.geometry_), 1ULL << (kMaxZoomLevel - z));
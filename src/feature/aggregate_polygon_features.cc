@@ -1,45 +1,71 @@
 #include "tiles/feature/aggregate_polygon_features.h"
 
 #include "utl/equal_ranges_linear.h"
-#include "utl/to_vec.h"
+#include "utl/erase_if.h"
 
 #include "tiles/feature/feature.h"
+#include "tiles/fixed/algo/clip.h"
 #include "tiles/fixed/algo/simplify.h"
-#include "tiles/fixed/convert.h"
 #include "tiles/util.h"
+#include "tiles/util_parallel.h"
 
 namespace tiles {
 
-std::vector<feature> aggregate_polygon_features(std::vector<feature> features,
-                                                uint32_t const z) {
+std::vector<feature> aggregate_polygon_features(
+    std::vector<feature> features, uint32_t const z,
+    queue_wrapper<std::function<void()>>* queue) {
   std::sort(
       begin(features), end(features), [](auto const& lhs, auto const& rhs) {
         return std::tie(lhs.meta_, lhs.id_) < std::tie(rhs.meta_, rhs.id_);
       });
 
+  // half a pixel on a 4096 extent tile at lvl z
+  auto const tolerance = static_cast<fixed_coord_t>(
+      z < kMaxZoomLevel ? (1ULL << (kMaxZoomLevel - z)) / 2 : 0);
+  auto const pixel_tolerance = static_cast<uint32_t>(
+      z < kMaxZoomLevel ? 1ULL << (kMaxZoomLevel - z) : 0);
+
   std::vector<feature> result;
+  std::vector<std::function<void()>> tasks;
   utl::equal_ranges_linear(
       features,
       [](auto const& lhs, auto const& rhs) { return lhs.meta_ == rhs.meta_; },
       [&](auto lb, auto ub) {
-        fixed_polygon final_polygon;
-        for (auto it = lb; it != ub; ++it) {
-          for (auto& p : mpark::get<fixed_polygon>(it->geometry_)) {
-            final_polygon.emplace_back(std::move(p));
-          }
-        }
-
-        feature f;
+        auto& f = result.emplace_back();
         f.id_ = lb->id_;
+        f.layer_ = lb->layer_;
+        f.zoom_levels_ = lb->zoom_levels_;
         f.meta_ = std::move(lb->meta_);
+        f.shared_meta_ids_ = std::move(lb->shared_meta_ids_);
 
-        // TODO this is a noop
-        f.geometry_ =
-            simplify(std::move(final_polygon), 1ULL << (kMaxZoomLevel - z));
-
-        result.emplace_back(std::move(f));
+        tasks.emplace_back([&, lb, ub, idx = result.size() - 1] {
+          fixed_polygon polygons;
+          for (auto it = lb; it != ub; ++it) {
+            for (auto& p : mpark::get<fixed_polygon>(it->geometry_)) {
+              polygons.emplace_back(std::move(p));
+            }
+          }
+          auto geometry = union_polygons(polygons, tolerance);
+          if (mpark::holds_alternative<fixed_polygon>(geometry)) {
+            // (topology safe) simplify the union, one pixel (4096 extent)
+            geometry = simplify(mpark::get<fixed_polygon>(std::move(geometry)),
+                                pixel_tolerance);
+          }
+          result[idx].geometry_ = std::move(geometry);
+        });
       });
 
+  if (queue != nullptr && tasks.size() > 1) {
+    process_and_wait(*queue, std::move(tasks));
+  } else {
+    for (auto& task : tasks) {
+      task();
+    }
+  }
+
+  utl::erase_if(result, [](auto const& f) {
+    return mpark::holds_alternative<fixed_null>(f.geometry_);
+  });
   return result;
 }
 
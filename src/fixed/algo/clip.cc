@@ -1,5 +1,7 @@
 #include "tiles/fixed/algo/clip.h"
 
+#include <algorithm>
+
 #include "boost/geometry.hpp"
 
 #include "clipper/clipper.hpp"
@@ -117,4 +119,88 @@ fixed_geometry clip(fixed_geometry const& in, fixed_box const& box) {
   return mpark::visit([&](auto const& arg) { return clip(arg, box); }, in);
 }
 
+fixed_geometry union_polygons(fixed_polygon const& in,
+                              fixed_coord_t const tolerance) {
+  cl::Paths subject;
+  auto const add_ring = [&](fixed_ring const& ring) {
+    subject.emplace_back();
+    for (auto const& pt : ring) {
+      subject.back().emplace_back(pt.x(), pt.y());
+    }
+    subject.back().pop_back();
+  };
+  for (auto const& poly : in) {
+    add_ring(poly.outer());
+    for (auto const& inner : poly.inners()) {
+      add_ring(inner);
+    }
+  }
+
+  if (tolerance > 0) {
+    cl::CleanPolygons(subject, static_cast<double>(tolerance));
+    utl::erase_if(subject, [](auto const& path) { return path.size() < 3; });
+  }
+
+  cl::Clipper clpr;
+  clpr.AddPaths(subject, cl::ptSubject, true);
+
+  cl::PolyTree solution;
+  clpr.Execute(cl::ctUnion, solution, cl::pftNonZero, cl::pftNonZero);
+  if (solution.Childs.empty()) {
+    return fixed_null{};
+  }
+
+  fixed_polygon out;
+  to_fixed_polygon2(out, solution.Childs);
+
+  boost::geometry::correct(out);
+  return out;
+}
+
+fixed_geometry union_boxes(std::vector<fixed_box> const& boxes) {
+  fixed_polygon polygon;
+  polygon.reserve(boxes.size());
+  for (auto const& box : boxes) {
+    polygon.emplace_back(std::move(to_polygon(box).front()));
+  }
+  return union_polygons(polygon, 0);
+}
+
+bool covers(fixed_polygon const& polygon, fixed_box const& box) {
+  auto const touches = [&](fixed_ring const& ring) {
+    for (auto i = 0ULL; i < ring.size(); ++i) {
+      auto const& a = ring[i];
+      auto const& b = ring[(i + 1) % ring.size()];
+      if (std::max(a.x(), b.x()) >= box.min_corner().x() &&
+          std::min(a.x(), b.x()) <= box.max_corner().x() &&
+          std::max(a.y(), b.y()) >= box.min_corner().y() &&
+          std::min(a.y(), b.y()) <= box.max_corner().y()) {
+        return true;  // conservative: segment bbox overlaps
+      }
+    }
+    return false;
+  };
+
+  for (auto const& simple : polygon) {
+    if (touches(simple.outer()) ||
+        std::any_of(begin(simple.inners()), end(simple.inners()), touches)) {
+      return false;
+    }
+  }
+
+  // no ring touches the box -> it is either completely inside or outside
+  return boost::geometry::covered_by(box.min_corner(), polygon);
+}
+
+fixed_polygon to_polygon(fixed_box const& box) {
+  fixed_polygon polygon{
+      fixed_simple_polygon{{{box.min_corner().x(), box.min_corner().y()},
+                            {box.min_corner().x(), box.max_corner().y()},
+                            {box.max_corner().x(), box.max_corner().y()},
+                            {box.max_corner().x(), box.min_corner().y()},
+                            {box.min_corner().x(), box.min_corner().y()}}}};
+  boost::geometry::correct(polygon);
+  return polygon;
+}
+
 }  // namespace tiles
@@ -183,4 +183,18 @@ fixed_geometry deserialize(std::string_view geo,
   }
 }
 
+fixed_geometry deserialize_empty(std::string_view geo) {
+  pz::pbf_message<tags::fixed_geometry> m{geo};
+  utl::verify(m.next(), "invalid msg");
+  utl::verify(m.tag() == tags::fixed_geometry::required_fixed_geometry_type,
+              "invalid tag");
+
+  switch (static_cast<tags::fixed_geometry_type>(m.get_enum())) {
+    case tags::fixed_geometry_type::POINT: return fixed_point{};
+    case tags::fixed_geometry_type::POLYLINE: return fixed_polyline{};
+    case tags::fixed_geometry_type::POLYGON: return fixed_polygon{};
+    default: throw utl::fail("unknown geometry");
+  }
+}
+
 }  // namespace tiles
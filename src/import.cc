@@ -7,9 +7,13 @@
 #include "tiles/db/database_stats.h"
 #include "tiles/db/feature_inserter_mt.h"
 #include "tiles/db/feature_pack.h"
+#include "tiles/db/feature_pyramid.h"
+#include "tiles/db/features_key_layout.h"
+#include "tiles/db/pack_compression.h"
 #include "tiles/db/pack_file.h"
 #include "tiles/db/prepare_tiles.h"
 #include "tiles/db/tile_database.h"
+#include "tiles/get_tile.h"
 #include "tiles/osm/feature_handler.h"
 #include "tiles/osm/load_coastlines.h"
 #include "tiles/osm/load_osm.h"
@@ -25,7 +29,14 @@ struct import_settings : public conf::configuration {
     param(tmp_dname_, "tmp_dname", "/path/to/tmp/directory");
     param(tasks_, "tasks",
           "'all' or any combination of: 'coastlines', "
-          "'features', 'stats', 'pack', 'tiles'");
+          "'features', 'stats', 'pack', 'migrate', 'pyramid', 'tiles'");
+    param(pack_codec_, "pack_codec",
+          "feature pack compression: 'none', 'deflate', 'deflate-dict'");
+    param(pack_index_, "pack_index",
+          "feature pack spatial index: 'quad_tree', 'hilbert_rtree'");
+    param(tile_extents_, "tile_extents",
+          "mvt extent per zoom level starting at z0 (e.g. 512 1024 2048), "
+          "4096 for all others; also used by the server");
   }
 
   bool has_any_task(std::vector<std::string> const& query) const {
@@ -41,6 +52,9 @@ struct import_settings : public conf::configuration {
   std::string coastlines_fname_{"land-polygons-complete-4326.zip"};
   std::string tmp_dname_{"."};
   std::vector<std::string> tasks_{{"all"}};
+  std::string pack_codec_{"none"};
+  std::string pack_index_{"quad_tree"};
+  std::vector<uint32_t> tile_extents_;
 };
 
 int run_tiles_import(int argc, char const** argv) {
@@ -66,6 +80,9 @@ int run_tiles_import(int argc, char const** argv) {
   if (opt.has_any_task({"features"})) {
     check_profile(opt.osm_profile_);
   }
+  auto const codec = parse_pack_codec(opt.pack_codec_);  // fail early
+  auto const index = parse_pack_index(opt.pack_index_);
+  verify_tile_extents(opt.tile_extents_);
 
   if (opt.has_any_task({"coastlines", "features"})) {
     t_log("clear database");
@@ -76,6 +93,7 @@ int run_tiles_import(int argc, char const** argv) {
   lmdb::env db_env = make_tile_database(opt.db_fname_.c_str());
   tile_db_handle db_handle{db_env};
   pack_handle pack_handle{opt.db_fname_.c_str()};
+  load_pack_dictionary(db_handle, pack_handle);
 
   {
     feature_inserter_mt inserter{
@@ -99,12 +117,22 @@ int run_tiles_import(int argc, char const** argv) {
 
   if (opt.has_any_task({"pack"})) {
     t_log("pack features");
-    pack_features(db_handle, pack_handle);
+    pack_features(db_handle, pack_handle, codec, index);
+  }
+
+  if (opt.has_any_task({"migrate"})) {  // no-op after pack
+    t_log("migrate features key layout");
+    migrate_features_key_layout(db_handle, kDefaultFeaturesKeyLayout);
+  }
+
+  if (opt.has_any_task({"pyramid"})) {
+    t_log("build feature pyramid");
+    build_feature_pyramid(db_handle, pack_handle);
   }
 
   if (opt.has_any_task({"tiles"})) {
     t_log("prepare tiles");
-    prepare_tiles(db_handle, pack_handle, 10);
+    prepare_tiles(db_handle, pack_handle, 10, opt.tile_extents_);
   }
 
   t_log("import done!");
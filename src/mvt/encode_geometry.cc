@@ -1,10 +1,16 @@
 #include "tiles/mvt/encode_geometry.h"
 
 #include <iostream>
+#include <optional>
 
 #include "boost/geometry.hpp"
 
+#include "protozero/pbf_message.hpp"
+
+#include "geo/simplify_mask.h"
+
 #include "tiles/fixed/algo/delta.h"
+#include "tiles/fixed/io/tags.h"
 #include "tiles/mvt/tags.h"
 #include "tiles/util.h"
 
@@ -24,9 +30,12 @@ uint32_t encode_command(command cmd, uint32_t count) {
 constexpr auto geometry_tag =
     static_cast<pz::pbf_tag_type>(ttm::Feature::packed_uint32_geometry);
 
-std::pair<delta_encoder, delta_encoder> delta_encoders(fixed_box const& box) {
-  return {delta_encoder{static_cast<fixed_coord_t>(box.min_corner().x())},
-          delta_encoder{static_cast<fixed_coord_t>(box.min_corner().y())}};
+std::pair<delta_encoder, delta_encoder> delta_encoders(tile_spec const& spec) {
+  auto const& min = spec.px_bounds_.min_corner();
+  return {delta_encoder{static_cast<fixed_coord_t>(min.x() >>
+                                                   spec.extent_shift_)},
+          delta_encoder{static_cast<fixed_coord_t>(min.y() >>
+                                                   spec.extent_shift_)}};
 }
 
 void encode(pz::pbf_builder<ttm::Feature>&, fixed_null const&,
@@ -36,7 +45,7 @@ void encode(pz::pbf_builder<ttm::Feature>& pb, fixed_point const& point,
             tile_spec const& spec) {
   pb.add_enum(ttm::Feature::optional_GeomType_type, ttm::GeomType::POINT);
 
-  auto [x_enc, y_enc] = delta_encoders(spec.px_bounds_);
+  auto [x_enc, y_enc] = delta_encoders(spec);
   {
     pz::packed_field_uint32 sw{pb, geometry_tag};
     sw.add_element(encode_command(MOVE_TO, point.size()));
@@ -75,7 +84,7 @@ void encode(pz::pbf_builder<ttm::Feature>& pb,
             fixed_polyline const& multi_polyline, tile_spec const& spec) {
   pb.add_enum(ttm::Feature::optional_GeomType_type, ttm::GeomType::LINESTRING);
 
-  auto [x_enc, y_enc] = delta_encoders(spec.px_bounds_);
+  auto [x_enc, y_enc] = delta_encoders(spec);
   {
     pz::packed_field_uint32 sw{pb, geometry_tag};
 
@@ -90,7 +99,7 @@ void encode(pz::pbf_builder<ttm::Feature>& pb,
   pb.add_enum(ttm::Feature::optional_GeomType_type, ttm::GeomType::POLYGON);
   utl::verify(!multi_polygon.empty(), "multi_polygon empty");
 
-  auto [x_enc, y_enc] = delta_encoders(spec.px_bounds_);
+  auto [x_enc, y_enc] = delta_encoders(spec);
   {
     pz::packed_field_uint32 sw{pb, geometry_tag};
 
@@ -108,4 +117,175 @@ void encode_geometry(pz::pbf_builder<ttm::Feature>& pb,
   mpark::visit([&](auto const& arg) { encode(pb, arg, spec); }, geometry);
 }
 
+struct geometry_transcoder {
+  using range_t = pz::iterator_range<pz::pbf_reader::const_sint64_iterator>;
+
+  geometry_transcoder(range_t range,
+                      std::vector<std::string_view> const& simplify_masks,
+                      tile_spec const& spec)
+      : range_{std::move(range)},
+        simplify_masks_{simplify_masks},
+        z_{spec.tile_.z_},
+        delta_z_{kMaxZoomLevel - spec.tile_.z_ + spec.extent_shift_},
+        encoders_{delta_encoders(spec)} {}
+
+  fixed_delta_t get_next() {
+    utl::verify(range_.first != range_.second, "iterator problem");
+    auto val = *range_.first;
+    ++range_.first;
+    return val;
+  }
+
+  // reads next point sequence into path_ (simplified, shifted, deduplicated)
+  // returns the number of points before shift (see deserialize_polygon)
+  size_t read_path() {
+    path_.clear();
+
+    auto const size = get_next();
+    std::optional<geo::simplify_mask_reader> reader;
+    if (!simplify_masks_.empty()) {
+      utl::verify(curr_mask_ < simplify_masks_.size(), "mask part missing");
+      reader.emplace(simplify_masks_[curr_mask_++].data(), z_);
+      utl::verify(size == reader->size_, "simplify mask size mismatch");
+    }
+
+    size_t count = 0;
+    for (auto i = 0LL; i < size; ++i) {
+      // do not inline -> undefined execution order
+      auto const x_val = x_decoder_.decode(get_next());
+      auto const y_val = y_decoder_.decode(get_next());
+      if (reader && !reader->get_bit(i)) {
+        continue;
+      }
+
+      ++count;
+      fixed_xy pt{x_val >> delta_z_, y_val >> delta_z_};
+      if (path_.empty() || !(path_.back() == pt)) {
+        path_.emplace_back(pt);
+      }
+    }
+    return count;
+  }
+
+  void transcode_point(pz::packed_field_uint32& sw) {
+    read_path();
+    if (path_.empty()) {
+      return;
+    }
+
+    sw.add_element(encode_command(MOVE_TO, path_.size()));
+    for (auto const& p : path_) {
+      sw.add_element(encode_zigzag32(encoders_.first.encode(p.x())));
+      sw.add_element(encode_zigzag32(encoders_.second.encode(p.y())));
+    }
+    has_output_ = true;
+  }
+
+  void transcode_polyline(pz::packed_field_uint32& sw) {
+    auto const count = get_next();
+    for (auto i = 0LL; i < count; ++i) {
+      read_path();
+      if (path_.size() < 2) {
+        continue;
+      }
+
+      encode_path<false>(sw, encoders_.first, encoders_.second, path_);
+      has_output_ = true;
+    }
+  }
+
+  // orientation as in boost::geometry::correct (which is done by clip)
+  bool transcode_ring(pz::packed_field_uint32& sw, bool const is_outer) {
+    if (read_path() < 4 || path_.size() < 4) {  // see shift
+      return false;
+    }
+
+    auto const area = boost::geometry::area(path_);
+    if ((is_outer && area < 0) || (!is_outer && area > 0)) {
+      std::reverse(begin(path_), end(path_));
+    }
+
+    encode_path<true>(sw, encoders_.first, encoders_.second, path_);
+    return true;
+  }
+
+  void transcode_polygon(pz::packed_field_uint32& sw) {
+    auto const count = get_next();
+    for (auto i = 0LL; i < count; ++i) {
+      auto const has_outer = transcode_ring(sw, true);
+      has_output_ = has_output_ || has_outer;
+
+      auto const inner_count = get_next();
+      for (auto j = 0LL; j < inner_count; ++j) {
+        if (has_outer) {
+          transcode_ring(sw, false);
+        } else {
+          read_path();  // skip
+        }
+      }
+    }
+  }
+
+  range_t range_;
+  std::vector<std::string_view> const& simplify_masks_;
+  size_t curr_mask_{0};
+
+  uint32_t z_, delta_z_;
+
+  delta_decoder x_decoder_{kFixedCoordMagicOffset};
+  delta_decoder y_decoder_{kFixedCoordMagicOffset};
+  std::pair<delta_encoder, delta_encoder> encoders_;
+
+  fixed_ring path_;
+  bool has_output_{false};
+};
+
+bool transcode_geometry(pz::pbf_builder<ttm::Feature>& pb,
+                        std::string_view geo,
+                        std::vector<std::string_view> const& simplify_masks,
+                        tile_spec const& spec) {
+  pz::pbf_message<tags::fixed_geometry> m{geo};
+  utl::verify(m.next(), "invalid msg");
+  utl::verify(m.tag() == tags::fixed_geometry::required_fixed_geometry_type,
+              "invalid tag");
+  auto const type = static_cast<tags::fixed_geometry_type>(m.get_enum());
+
+  utl::verify(m.next(), "invalid message");
+  utl::verify(m.tag() == tags::fixed_geometry::packed_sint64_geometry,
+              "invalid tag");
+  geometry_transcoder transcoder{m.get_packed_sint64(), simplify_masks, spec};
+
+  switch (type) {
+    case tags::fixed_geometry_type::POINT:
+      pb.add_enum(ttm::Feature::optional_GeomType_type, ttm::GeomType::POINT);
+      break;
+    case tags::fixed_geometry_type::POLYLINE:
+      pb.add_enum(ttm::Feature::optional_GeomType_type,
+                  ttm::GeomType::LINESTRING);
+      break;
+    case tags::fixed_geometry_type::POLYGON:
+      pb.add_enum(ttm::Feature::optional_GeomType_type, ttm::GeomType::POLYGON);
+      break;
+    default: throw utl::fail("unknown geometry");
+  }
+
+  {
+    pz::packed_field_uint32 sw{pb, geometry_tag};
+    switch (type) {
+      case tags::fixed_geometry_type::POINT:
+        transcoder.transcode_point(sw);
+        break;
+      case tags::fixed_geometry_type::POLYLINE:
+        transcoder.transcode_polyline(sw);
+        break;
+      case tags::fixed_geometry_type::POLYGON:
+        transcoder.transcode_polygon(sw);
+        break;
+      default: throw utl::fail("unknown geometry");
+    }
+  }
+
+  return transcoder.has_output_;
+}
+
 }  // namespace tiles
@@ -1,18 +1,27 @@
 #include "tiles/mvt/tile_builder.h"
 
+#include <algorithm>
 #include <iostream>
+#include <cmath>
 #include <limits>
-#include <unordered_set>
+#include <numeric>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
 
 #include "boost/algorithm/string/predicate.hpp"
+#include "boost/geometry.hpp"
 
+#include "utl/erase_if.h"
 #include "utl/get_or_create.h"
 #include "utl/get_or_create_index.h"
+#include "utl/to_vec.h"
 
 #include "tiles/bin_utils.h"
 #include "tiles/feature/aggregate_line_features.h"
 #include "tiles/feature/aggregate_polygon_features.h"
 #include "tiles/fixed/algo/area.h"
+#include "tiles/fixed/algo/bounding_box.h"
 #include "tiles/fixed/algo/clip.h"
 #include "tiles/fixed/algo/shift.h"
 #include "tiles/fixed/io/deserialize.h"
@@ -21,17 +30,18 @@
 #include "tiles/mvt/encode_geometry.h"
 #include "tiles/mvt/tags.h"
 #include "tiles/util.h"
+#include "tiles/util_parallel.h"
 
 using namespace protozero;
 namespace ttm = tiles::tags::mvt;
 
 namespace tiles {
 
-constexpr auto const kVectorTileExtend = 4096;
 constexpr auto const kRasterTileExtend = 256;
 constexpr auto const kScreenPixelArea =
     (kVectorTileExtend / kRasterTileExtend) *
     (kVectorTileExtend / kRasterTileExtend);
+static_assert(kScreenPixelArea == 1 << kScreenPixelAreaLog2);
 
 struct layer_builder {
   layer_builder(render_ctx const& ctx, std::string layer_name,
@@ -41,85 +51,216 @@ struct layer_builder {
         spec_{spec},
         has_geometry_{false},
         pb_{buf_} {
+    write_header(spec_.extent_);
+  }
+
+  void write_header(uint32_t const extent) {
     pb_.add_uint32(ttm::Layer::required_uint32_version, 2);
     pb_.add_string(ttm::Layer::required_string_name, layer_name_);
-    pb_.add_uint32(ttm::Layer::optional_uint32_extent, kVectorTileExtend);
+    pb_.add_uint32(ttm::Layer::optional_uint32_extent, extent);
   }
 
-  void add_feature(feature f) {
-    if ((mpark::holds_alternative<fixed_point>(f.geometry_) &&
-         !node_ids_.insert(f.id_).second) ||
-        (mpark::holds_alternative<fixed_polyline>(f.geometry_) &&
-         !line_ids_.insert(f.id_).second) ||
-        (mpark::holds_alternative<fixed_polygon>(f.geometry_) &&
-         !poly_ids_.insert(f.id_).second)) {
-      return;
+  // NOTE: no deduplication here, see home_bucket_hint
+  // false: nothing left (e.g. clipped away or removed by the simplify mask)
+  bool add_feature(feature f) {
+    if (!insert_feature(std::move(f))) {
+      return false;
     }
-
     ++features_added_;
+    return true;
+  }
+
+  bool insert_feature(feature f) {
     if (mpark::holds_alternative<fixed_null>(f.geometry_)) {
-      return;
+      return false;
     }
 
     if (ctx_.tb_aggregate_lines_ &&
         mpark::holds_alternative<fixed_polyline>(f.geometry_)) {
+      if (!deserialize_geometry(f)) {
+        return false;
+      }
       line_buffer_.emplace_back(std::move(f));
+      return true;
     } else if (ctx_.tb_aggregate_polygons_ &&
                mpark::holds_alternative<fixed_polygon>(f.geometry_)) {
+      if (!deserialize_geometry(f)) {
+        return false;
+      }
       polygon_buffer_.emplace_back(std::move(f));
+      return true;
+    } else if (!f.serialized_geometry_.empty() && !has_budget()) {
+      return write_feature(f);  // inside draw bounds: transcode, no clipping
     } else {
-      f.geometry_ = clip(f.geometry_, spec_.draw_bounds_);
-      f.geometry_ = shift(f.geometry_, spec_.tile_.z_);
-      write_feature(f);
+      if (!deserialize_geometry(f)) {  // budget: keep geometry, see coarsen
+        return false;
+      }
+      clip_and_shift(f);
+      return write_feature(f);
     }
   }
 
-  void write_feature(feature const& f) {
-    if (mpark::holds_alternative<fixed_null>(f.geometry_)) {
-      return;
+  bool has_budget() const { return ctx_.tb_max_tile_size_ != 0; }
+
+  void clip_and_shift(feature& f) const {
+    clip_geometry(f);
+    f.geometry_ = shift(f.geometry_, spec_.tile_.z_, spec_.extent_shift_);
+  }
+
+  void clip_geometry(feature& f) const {
+    auto const& box = spec_.draw_bounds_;
+    auto const& bbox = f.bbox_;
+    if (bbox.min_corner().x() != kInvalidBoxHint &&
+        bbox.min_corner().x() > box.min_corner().x() &&
+        bbox.min_corner().y() > box.min_corner().y() &&
+        bbox.max_corner().x() < box.max_corner().x() &&
+        bbox.max_corner().y() < box.max_corner().y()) {
+      // fully inside: nothing to clip (clip would correct polygons)
+      if (auto* polygon = mpark::get_if<fixed_polygon>(&f.geometry_)) {
+        boost::geometry::correct(*polygon);
+      }
+    } else if (bbox.min_corner().x() != kInvalidBoxHint &&
+               bbox.min_corner().x() < box.min_corner().x() &&
+               bbox.min_corner().y() < box.min_corner().y() &&
+               bbox.max_corner().x() > box.max_corner().x() &&
+               bbox.max_corner().y() > box.max_corner().y() &&
+               mpark::holds_alternative<fixed_polygon>(f.geometry_) &&
+               covers(mpark::get<fixed_polygon>(f.geometry_), box)) {
+      // huge polygon (landuse, water, ...) covering the whole tile
+      f.geometry_ = to_polygon(box);
+    } else {
+      f.geometry_ = clip(f.geometry_, box);
     }
+  }
 
-    has_geometry_ = true;
-    ++features_written_;
+  bool deserialize_geometry(feature& f) const {
+    if (f.serialized_geometry_.empty()) {
+      return true;
+    }
+
+    f.geometry_ =
+        f.simplify_masks_.empty()
+            ? deserialize(f.serialized_geometry_)
+            : deserialize(f.serialized_geometry_, std::move(f.simplify_masks_),
+                          spec_.tile_.z_);
+    f.serialized_geometry_ = {};
+    f.simplify_masks_ = {};
+    return !mpark::holds_alternative<fixed_null>(f.geometry_);
+  }
+
+  bool write_feature(feature& f) {
+    if (mpark::holds_alternative<fixed_null>(f.geometry_)) {
+      return false;
+    }
 
     std::string feature_buf;
     pbf_builder<ttm::Feature> feature_pb(feature_buf);
 
-    encode_geometry(feature_pb, f.geometry_, spec_);
+    if (!f.serialized_geometry_.empty()) {
+      if (!transcode_geometry(feature_pb, f.serialized_geometry_,
+                              f.simplify_masks_, spec_)) {
+        return false;  // e.g. killed by the simplify mask
+      }
+    } else {
+      encode_geometry(feature_pb, f.geometry_, spec_);
+    }
+
+    has_geometry_ = true;
+    ++features_written_;
 
     feature_pb.add_uint64(ttm::Feature::optional_uint64_id, f.id_);
-    write_metadata(feature_pb, f.meta_);
-    pb_.add_message(ttm::Layer::repeated_Feature_features, feature_buf);
+    auto tags = make_tags(f);
+
+    if (has_budget()) {  // decided later: see apply_budget
+      budget_features_.push_back({budget_area(f), std::move(tags), false,
+                                  std::move(feature_buf), f.id_,
+                                  std::move(f.geometry_)});
+    } else {
+      feature_pb.add_packed_uint32(ttm::Feature::packed_uint32_tags,
+                                   begin(tags), end(tags));
+      pb_.add_message(ttm::Layer::repeated_Feature_features, feature_buf);
+    }
+    return true;
+  }
+
+  // bounding box area in tile coordinates (geometry_ is shifted already)
+  // points count as a small label (8x8 screen pixels) instead of zero
+  fixed_coord_t budget_area(feature const& f) const {
+    if (mpark::holds_alternative<fixed_point>(f.geometry_)) {
+      return (64 * kScreenPixelArea) >> (2 * spec_.extent_shift_);
+    }
+    return area(bounding_box(f.geometry_));
   }
 
-  void write_metadata(pbf_builder<ttm::Feature>& pb,
-                      std::vector<metadata> const& meta) {
+  static bool is_hidden_key(std::string const& key) {
+    return key == "layer" || boost::starts_with(key, "__");
+  }
+
+  // key/value index pairs into meta_key/value_cache_
+  std::vector<uint32_t> make_tags(feature const& f) {
     std::vector<uint32_t> t;
 
-    for (auto const& m : meta) {
-      if (m.key_ == "layer" || boost::starts_with(m.key_, "__")) {
+    // dictionary coded: string lookups only once per distinct key/value
+    auto const& dec = ctx_.metadata_decoder_;
+    for (auto i = 0ULL; i < f.shared_meta_ids_.size(); ++i) {
+      auto const id = f.shared_meta_ids_[i];
+      auto const& m = f.meta_[i];
+
+      if (shared_key_idx_.empty()) {
+        shared_key_idx_.resize(dec.key_count_, kUnknownMetaIdx);
+      }
+      auto& key_idx = shared_key_idx_[dec.key_ids_[id]];
+      if (key_idx == kUnknownMetaIdx) {
+        key_idx = is_hidden_key(m.key_)
+                      ? kHiddenMetaIdx
+                      : static_cast<uint32_t>(utl::get_or_create_index(
+                            meta_key_cache_, m.key_));
+      }
+      if (key_idx == kHiddenMetaIdx) {
+        continue;
+      }
+
+      t.emplace_back(key_idx);
+      t.emplace_back(utl::get_or_create(
+          shared_value_idx_, dec.value_ids_[id], [&] {
+            return static_cast<uint32_t>(
+                utl::get_or_create_index(meta_value_cache_, m.value_));
+          }));
+    }
+
+    for (auto i = f.shared_meta_ids_.size(); i < f.meta_.size(); ++i) {
+      auto const& m = f.meta_[i];
+      if (is_hidden_key(m.key_)) {
         continue;
       }
 
       t.emplace_back(utl::get_or_create_index(meta_key_cache_, m.key_));
       t.emplace_back(utl::get_or_create_index(meta_value_cache_, m.value_));
     }
-
-    pb.add_packed_uint32(ttm::Feature::packed_uint32_tags, begin(t), end(t));
+    return t;
   }
 
   void aggregate_geometry() {
     if (ctx_.tb_aggregate_polygons_ && !polygon_buffer_.empty()) {
-      //   for (auto&& f :
-      //   aggregate_polygon_features(std::move(polygon_buffer_),
-      //                                              spec_.tile_.z_)) {
+      for (auto& f : polygon_buffer_) {
+        clip_geometry(f);
+      }
+      utl::erase_if(polygon_buffer_, [](auto const& f) {
+        return mpark::holds_alternative<fixed_null>(f.geometry_);
+      });
+
+      if (spec_.tile_.z_ <= kAggregatePolygonMaxZoomLevel) {
+        polygon_buffer_ =
+            aggregate_polygon_features(std::move(polygon_buffer_),
+                                       spec_.tile_.z_, ctx_.tb_layer_queue_);
+      }
 
       for (auto& f : polygon_buffer_) {
-        f.geometry_ = clip(f.geometry_, spec_.draw_bounds_);
-        f.geometry_ = shift(f.geometry_, spec_.tile_.z_);
+        f.geometry_ = shift(f.geometry_, spec_.tile_.z_, spec_.extent_shift_);
 
         if (f.layer_ != kLayerCoastlineIdx && ctx_.tb_drop_subpixel_polygons_ &&
-            area(f.geometry_) < kScreenPixelArea) {
+            area(f.geometry_) <
+                (kScreenPixelArea >> (2 * spec_.extent_shift_))) {
           continue;
         }
 
@@ -131,26 +272,189 @@ struct layer_builder {
       for (auto& f :
            aggregate_line_features(std::move(line_buffer_), spec_.tile_.z_)) {
         f.geometry_ = clip(f.geometry_, spec_.draw_bounds_);
-        f.geometry_ = shift(f.geometry_, spec_.tile_.z_);
+        f.geometry_ = shift(f.geometry_, spec_.tile_.z_, spec_.extent_shift_);
         write_feature(f);
       }
     }
   }
 
+  // priority within the layer: smallest area first, then fewest tags
+  void rank_budget_features() {
+    budget_order_.resize(budget_features_.size());
+    std::iota(begin(budget_order_), end(budget_order_), 0ULL);
+    std::stable_sort(begin(budget_order_), end(budget_order_),
+                     [&](auto const a, auto const b) {
+                       auto const& fa = budget_features_[a];
+                       auto const& fb = budget_features_[b];
+                       return std::pair{fa.area_, fa.tags_.size()} <
+                              std::pair{fb.area_, fb.tags_.size()};
+                     });
+  }
+
+  // drops the lowest ranked share of the features (see rank_budget_features)
+  void drop_budget_features(double const share) {
+    auto const n = std::min(
+        budget_order_.size(),
+        static_cast<size_t>(std::ceil(share * budget_order_.size())));
+    for (auto i = 0ULL; i < n; ++i) {
+      auto& e = budget_features_[budget_order_[i]];
+      if (!e.dropped_) {
+        e.dropped_ = true;
+        ++features_dropped_;
+      }
+    }
+    has_geometry_ = features_dropped_ < budget_features_.size();
+  }
+
+  // re-encodes the remaining features with extent (spec_.extent_ >> shift)
+  // from their geometry (not cumulative: always relative to spec_)
+  void coarsen_budget_features(uint32_t const coarsen_shift) {
+    coarsen_shift_ = coarsen_shift;
+    auto const coarse_spec =
+        tile_spec{spec_.tile_, spec_.extent_ >> coarsen_shift};
+    for (auto& e : budget_features_) {
+      if (e.dropped_) {
+        continue;
+      }
+
+      auto const geometry = shift(e.geometry_, kMaxZoomLevel, coarsen_shift);
+      if (mpark::holds_alternative<fixed_null>(geometry)) {
+        e.dropped_ = true;  // degenerated on the coarser grid
+        ++features_dropped_;
+        continue;
+      }
+
+      e.buf_.clear();
+      pbf_builder<ttm::Feature> feature_pb(e.buf_);
+      encode_geometry(feature_pb, geometry, coarse_spec);
+      feature_pb.add_uint64(ttm::Feature::optional_uint64_id, e.id_);
+    }
+    has_geometry_ = features_dropped_ < budget_features_.size();
+  }
+
+  // keys and values referenced by the remaining features -> new index
+  // (dropped features must not leave their metadata in the layer tables)
+  std::pair<std::vector<uint32_t>, std::vector<uint32_t>> meta_remap() const {
+    if (budget_features_.empty()) {  // everything interned is written
+      std::vector<uint32_t> keys(meta_key_cache_.size());
+      std::vector<uint32_t> values(meta_value_cache_.size());
+      std::iota(begin(keys), end(keys), 0U);
+      std::iota(begin(values), end(values), 0U);
+      return {keys, values};
+    }
+
+    std::vector<uint32_t> keys(meta_key_cache_.size(), kUnknownMetaIdx);
+    std::vector<uint32_t> values(meta_value_cache_.size(), kUnknownMetaIdx);
+    for (auto const& e : budget_features_) {
+      for (auto i = 0ULL; !e.dropped_ && i < e.tags_.size(); i += 2) {
+        keys[e.tags_[i]] = 0;
+        values[e.tags_[i + 1]] = 0;
+      }
+    }
+    for (auto* remap : {&keys, &values}) {
+      auto next = 0U;
+      for (auto& idx : *remap) {
+        idx = (idx == kUnknownMetaIdx) ? kUnknownMetaIdx : next++;
+      }
+    }
+    return {keys, values};
+  }
+
+  static size_t varint_size(uint64_t value) {
+    auto n = size_t{1};
+    while (value >= 0x80ULL) {
+      value >>= 7ULL;
+      ++n;
+    }
+    return n;
+  }
+
+  // length delimited field: key, size, and data
+  static size_t field_size(size_t const data_size) {
+    return 1 + varint_size(data_size) + data_size;
+  }
+
+  // encoded size of the packed tags field (with remapped indices)
+  static size_t tags_size(std::vector<uint32_t> const& tags,
+                          std::vector<uint32_t> const& key_remap,
+                          std::vector<uint32_t> const& value_remap) {
+    if (tags.empty()) {
+      return 0;
+    }
+    auto size = 0ULL;
+    for (auto i = 0ULL; i < tags.size(); i += 2) {
+      size += varint_size(key_remap[tags[i]]) +
+              varint_size(value_remap[tags[i + 1]]);
+    }
+    return field_size(size);
+  }
+
+  // size estimate of the finished layer (without the layer message overhead,
+  // values are counted with their stored size)
+  size_t budget_size() const {
+    auto const [keys, values] = meta_remap();
+
+    auto size = buf_.size();
+    for (auto const& e : budget_features_) {
+      if (!e.dropped_) {
+        size += field_size(e.buf_.size() + tags_size(e.tags_, keys, values));
+      }
+    }
+    for (auto const& pair : meta_key_cache_) {
+      if (keys[pair.second] != kUnknownMetaIdx) {
+        size += field_size(pair.first.size());
+      }
+    }
+    for (auto const& pair : meta_value_cache_) {
+      if (values[pair.second] != kUnknownMetaIdx) {
+        size += field_size(pair.first.size());
+      }
+    }
+    return size;
+  }
+
   std::string finish() {
+    if (coarsen_shift_ != 0) {  // nothing but the header written yet
+      buf_.clear();
+      write_header(spec_.extent_ >> coarsen_shift_);
+    }
+
+    auto const [key_remap, value_remap] = meta_remap();
+
+    for (auto& e : budget_features_) {
+      if (e.dropped_) {
+        continue;
+      }
+      for (auto i = 0ULL; i < e.tags_.size(); i += 2) {
+        e.tags_[i] = key_remap[e.tags_[i]];
+        e.tags_[i + 1] = value_remap[e.tags_[i + 1]];
+      }
+      pbf_builder<ttm::Feature> feature_pb(e.buf_);
+      feature_pb.add_packed_uint32(ttm::Feature::packed_uint32_tags,
+                                   begin(e.tags_), end(e.tags_));
+      pb_.add_message(ttm::Layer::repeated_Feature_features, e.buf_);
+    }
+
     std::vector<std::string const*> keys(meta_key_cache_.size());
     for (auto const& pair : meta_key_cache_) {
       keys[pair.second] = &pair.first;
     }
-    for (auto const& key : keys) {
-      pb_.add_string(ttm::Layer::repeated_string_keys, *key);
+    for (auto i = 0ULL; i < keys.size(); ++i) {
+      if (key_remap[i] != kUnknownMetaIdx) {  // remap keeps the order
+        pb_.add_string(ttm::Layer::repeated_string_keys, *keys[i]);
+      }
     }
 
     std::vector<std::string const*> values(meta_value_cache_.size());
     for (auto const& pair : meta_value_cache_) {
       values[pair.second] = &pair.first;
     }
-    for (auto const& value : values) {
+    for (auto i = 0ULL; i < values.size(); ++i) {
+      if (value_remap[i] == kUnknownMetaIdx) {
+        continue;
+      }
+
+      auto const& value = values[i];
       pbf_builder<ttm::Value> val_pb(pb_, ttm::Layer::repeated_Value_values);
 
       static_assert(sizeof(metadata_value_t) == 1);
@@ -183,10 +487,13 @@ struct layer_builder {
     }
 
     if (ctx_.tb_print_stats_) {
-      fmt::print("tile layer: {:<10} added:{} written:{} ({})\n", layer_name_,
-                 printable_num{features_added_},
-                 printable_num{features_written_},
-                 printable_bytes{buf_.size()});
+      fmt::print(
+          "tile layer: {:<10} added:{} written:{} dropped:{} "
+          "({}, budget saved {})\n",
+          layer_name_, printable_num{features_added_},
+          printable_num{features_written_ - features_dropped_},
+          printable_num{features_dropped_}, printable_bytes{buf_.size()},
+          printable_bytes{bytes_dropped_});
     }
 
     return buf_;
@@ -206,40 +513,61 @@ struct layer_builder {
   std::map<std::string, size_t> meta_key_cache_;
   std::map<std::string, size_t> meta_value_cache_;
 
-  std::unordered_set<uint64_t> node_ids_, line_ids_, poly_ids_;
+  // shared metadata key/value ids -> index in meta_key/value_cache_
+  static constexpr auto const kUnknownMetaIdx =
+      std::numeric_limits<uint32_t>::max();
+  static constexpr auto const kHiddenMetaIdx = kUnknownMetaIdx - 1;
+  std::vector<uint32_t> shared_key_idx_;
+  std::unordered_map<uint32_t, uint32_t> shared_value_idx_;
+
+  // encoded features, only if ctx_.tb_max_tile_size_ is set
+  struct budget_feature {
+    fixed_coord_t area_;
+    std::vector<uint32_t> tags_;  // appended in finish (after remapping)
+    bool dropped_;
+    std::string buf_;  // geometry and id
+    uint64_t id_;
+    fixed_geometry geometry_;  // shifted, see coarsen_budget_features
+  };
+  std::vector<budget_feature> budget_features_;
+  std::vector<size_t> budget_order_;  // lowest priority first
+  uint32_t coarsen_shift_{0};
 
   size_t features_added_{0};
   size_t features_written_{0};
+  size_t features_dropped_{0};
+  size_t bytes_dropped_{0};
 };
 
 struct tile_builder::impl {
-  impl(render_ctx const& ctx, geo::tile const& tile) : ctx_{ctx}, spec_{tile} {}
+  impl(render_ctx const& ctx, geo::tile const& tile)
+      : ctx_{ctx}, spec_{tile, tile_extent(ctx, tile.z_)} {}
 
-  void add_feature(feature f) {
+  bool add_feature(feature f) {
     utl::verify(f.layer_ < ctx_.layer_names_.size(), "invalid layer in db");
     auto& builder = utl::get_or_create(builders_, f.layer_, [&] {
       return std::make_unique<layer_builder>(
           ctx_, ctx_.layer_names_.at(f.layer_), spec_);
     });
-    builder->add_feature(std::move(f));
+    return builder->add_feature(std::move(f));
   }
 
   std::string finish() {
     std::string buf;
     pbf_builder<ttm::Tile> pb(buf);
 
-    for (auto const& pair : builders_) {
-      pair.second->aggregate_geometry();
-
-      if (pair.second->has_geometry_) {
-        pb.add_message(ttm::Tile::repeated_Layer_layers, pair.second->finish());
+    for (auto const& layer_buf : finish_layers()) {
+      if (layer_buf) {
+        pb.add_message(ttm::Tile::repeated_Layer_layers, *layer_buf);
       }
     }
 
     if (ctx_.tb_render_debug_info_) {
       layer_builder lb{ctx_, "tiles_debug_info", spec_};
-      auto const& min = spec_.px_bounds_.min_corner();
-      auto const& max = spec_.px_bounds_.max_corner();
+      auto px_bounds = spec_.px_bounds_;
+      shift(px_bounds, kMaxZoomLevel, spec_.extent_shift_);
+      auto const& min = px_bounds.min_corner();
+      auto const& max = px_bounds.max_corner();
 
       {
         std::string feature_buf;
@@ -281,6 +609,120 @@ struct tile_builder::impl {
     return buf;
   }
 
+  std::vector<std::optional<std::string>> finish_layers() {
+    auto const has_budget = ctx_.tb_max_tile_size_ != 0;
+
+    std::vector<std::optional<std::string>> results(builders_.size());
+    std::vector<std::function<void()>> tasks;
+    for (auto const& pair : builders_) {
+      tasks.emplace_back([&, i = tasks.size(), builder = pair.second.get()] {
+        builder->aggregate_geometry();
+        if (!has_budget && builder->has_geometry_) {
+          results[i] = builder->finish();
+        }
+      });
+    }
+
+    if (ctx_.tb_layer_queue_ != nullptr && tasks.size() > 1) {
+      process_and_wait(*ctx_.tb_layer_queue_, std::move(tasks));
+    } else {
+      for (auto const& task : tasks) {
+        task();
+      }
+    }
+
+    if (has_budget) {
+      apply_budget();
+      auto i = 0ULL;
+      for (auto const& pair : builders_) {
+        if (pair.second->has_geometry_) {
+          results[i] = pair.second->finish();
+        }
+        ++i;
+      }
+    }
+    return results;
+  }
+
+  // until the tile fits into the budget:
+  // 1) every layer drops the same share of its lowest ranked features (see
+  //    layer_builder::rank_budget_features), at most kBudgetMaxDropSteps of
+  //    kBudgetSteps -> a thinned tile instead of an empty one
+  // 2) the remaining features get coarser coordinates (smaller extent), down
+  //    to one unit per screen pixel
+  // coastline is never dropped or coarsened (holes in the sea)
+  void apply_budget() {
+    std::vector<layer_builder*> layers;
+    for (auto const& pair : builders_) {
+      if (pair.first != kLayerCoastlineIdx) {
+        layers.push_back(pair.second.get());
+      }
+    }
+
+    auto const tile_size = [&] {
+      auto size = 0ULL;
+      for (auto const& pair : builders_) {
+        size += pair.second->budget_size();
+      }
+      return size;
+    };
+
+    auto size = tile_size();
+    if (size <= ctx_.tb_max_tile_size_) {
+      return;
+    }
+
+    auto const size_before = size;
+    auto const layer_sizes_before = utl::to_vec(
+        layers, [](layer_builder const* l) { return l->budget_size(); });
+
+    for (auto* layer : layers) {
+      layer->rank_budget_features();
+    }
+
+    constexpr auto const kBudgetSteps = 32;
+    constexpr auto const kBudgetMaxDropSteps = 24;
+    for (auto step = 1; step <= kBudgetMaxDropSteps; ++step) {
+      for (auto* layer : layers) {
+        layer->drop_budget_features(static_cast<double>(step) / kBudgetSteps);
+      }
+
+      size = tile_size();
+      if (size <= ctx_.tb_max_tile_size_) {
+        break;
+      }
+    }
+
+    auto coarsen_shift = 0U;
+    while (size > ctx_.tb_max_tile_size_ &&
+           (spec_.extent_ >> (coarsen_shift + 1)) >=
+               static_cast<uint32_t>(kRasterTileExtend)) {
+      ++coarsen_shift;
+      for (auto* layer : layers) {
+        layer->coarsen_budget_features(coarsen_shift);
+      }
+      size = tile_size();
+    }
+
+    auto dropped = 0ULL;
+    for (auto i = 0ULL; i < layers.size(); ++i) {
+      auto const layer_size = layers[i]->budget_size();
+      layers[i]->bytes_dropped_ = layer_sizes_before[i] > layer_size
+                                      ? layer_sizes_before[i] - layer_size
+                                      : 0ULL;
+      dropped += layers[i]->features_dropped_;
+    }
+
+    if (ctx_.tb_print_stats_) {
+      fmt::print(
+          "tile budget: {} > {} -> dropped {} features, extent {} ({})\n",
+          printable_bytes{size_before},
+          printable_bytes{ctx_.tb_max_tile_size_}, printable_num{dropped},
+          spec_.extent_ >> coarsen_shift,
+          printable_bytes{size_before > size ? size_before - size : 0ULL});
+    }
+  }
+
   render_ctx const& ctx_;
   tile_spec spec_;
   std::map<size_t, std::unique_ptr<layer_builder>> builders_;
@@ -291,7 +733,9 @@ tile_builder::tile_builder(render_ctx const& ctx, geo::tile const& tile)
 
 tile_builder::~tile_builder() = default;
 
-void tile_builder::add_feature(feature f) { impl_->add_feature(std::move(f)); }
+bool tile_builder::add_feature(feature f) {
+  return impl_->add_feature(std::move(f));
+}
 
 std::string tile_builder::finish() { return impl_->finish(); }
 
@@ -30,6 +30,10 @@ void print(char const* label, std::vector<uint64_t>& m) {
 
 void perf_report_get_tile(perf_counter& pc) {
   print<printable_bytes>(" RESULT: SIZE", pc.finished_[perf_task::RESULT_SIZE]);
+  print<printable_bytes>(" RESULT: SCANNED",
+                         pc.finished_[perf_task::RESULT_SCANNED_BYTES]);
+  print<printable_num>(" RESULT: FEATURES",
+                       pc.finished_[perf_task::RESULT_SCANNED_FEATURES]);
 
   print<printable_ns>(" GET: TOTAL", pc.finished_[perf_task::GET_TILE_TOTAL]);
   print<printable_ns>(" GET: FETCH", pc.finished_[perf_task::GET_TILE_FETCH]);
@@ -17,6 +17,7 @@
 
 #include "utl/parser/mmap_reader.h"
 
+#include "tiles/db/pack_compression.h"
 #include "tiles/db/tile_database.h"
 #include "tiles/get_tile.h"
 #include "tiles/parse_tile_url.h"
@@ -150,11 +151,17 @@ struct server_settings : public conf::configuration {
     param(db_fname_, "db_fname", "/path/to/tiles.mdb");
     param(res_dname_, "res_dname", "/path/to/res");
     param(port_, "port", "the http port of the server");
+    param(compress_level_, "compress_level",
+          "deflate level (0-9) for tiles rendered on demand");
+    param(max_tile_size_, "max_tile_size",
+          "byte budget per tile rendered on demand (0: unlimited)");
   }
 
   std::string db_fname_{"tiles.mdb"};
   std::string res_dname_;
   uint16_t port_{8888};
+  int compress_level_{kCompressLevelDefault};
+  size_t max_tile_size_{0};
 };
 
 int run_tiles_server(int argc, char const** argv) {
@@ -182,8 +189,11 @@ int run_tiles_server(int argc, char const** argv) {
 
   lmdb::env db_env = make_tile_database(opt.db_fname_.c_str());
   tile_db_handle handle{db_env};
-  auto const render_ctx = make_render_ctx(handle);
+  auto render_ctx = make_render_ctx(handle);
+  render_ctx.compress_level_ = opt.compress_level_;
+  render_ctx.tb_max_tile_size_ = opt.max_tile_size_;
   pack_handle pack_handle{opt.db_fname_.c_str()};
+  load_pack_dictionary(handle, pack_handle);
 
   auto const maybe_serve_tile = [&](auto const& req, auto& res) -> bool {
     static regex_matcher matcher{R"(^\/(\d+)\/(\d+)\/(\d+).mvt$)"};
@@ -193,9 +203,12 @@ int run_tiles_server(int argc, char const** argv) {
       return false;
     }
 
-    if (req[http::field::accept_encoding]  //
-            .find("deflate") == boost::string_view::npos) {
-      res.result(http::status::not_implemented);
+    auto const accept_encoding = req[http::field::accept_encoding];
+    auto const encoding = select_content_encoding(
+        std::string_view{accept_encoding.data(), accept_encoding.size()});
+    res.set(http::field::vary, "Accept-Encoding");
+    if (!encoding) {
+      res.result(http::status::not_acceptable);
       return true;
     }
 
@@ -207,8 +220,10 @@ int run_tiles_server(int argc, char const** argv) {
     perf_report_get_tile(pc);
 
     if (rendered_tile) {
-      res.body() = std::move(*rendered_tile);
-      res.set(http::field::content_encoding, "deflate");
+      res.body() = encode_tile(*rendered_tile, *encoding);
+      if (*encoding != content_encoding::identity) {
+        res.set(http::field::content_encoding, to_str(*encoding));
+      }
       res.result(http::status::ok);
     } else {
       res.result(http::status::no_content);
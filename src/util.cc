@@ -1,25 +1,204 @@
 #include "tiles/util.h"
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
 #include <regex>
+#include <utility>
 
 #include "zlib.h"
 
 #include "utl/to_vec.h"
 #include "utl/verify.h"
 
+#include "tiles/bin_utils.h"
+
 namespace tiles {
 
-std::string compress_deflate(std::string const& input) {
-  auto out_size = compressBound(input.size());
-  std::string buffer(out_size, '\0');
+struct deflate_compressor::impl {
+  explicit impl(int level) {
+    utl::verify(level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION,
+                "deflate_compressor: invalid level {}", level);
+    utl::verify(deflateInit(&stream_, level) == Z_OK,
+                "deflate_compressor: init failed");
+  }
+
+  ~impl() { deflateEnd(&stream_); }
+
+  impl(impl const&) = delete;
+  impl(impl&&) = delete;
+  impl& operator=(impl const&) = delete;
+  impl& operator=(impl&&) = delete;
+
+  std::string compress(std::string const& input) {
+    utl::verify(deflateReset(&stream_) == Z_OK,
+                "deflate_compressor: reset failed");
+
+    std::string buffer(deflateBound(&stream_, input.size()), '\0');
+    stream_.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));  // NOLINT
+    stream_.avail_in = static_cast<uInt>(input.size());
+    stream_.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+    stream_.avail_out = static_cast<uInt>(buffer.size());
+
+    utl::verify(deflate(&stream_, Z_FINISH) == Z_STREAM_END,
+                "compress_deflate failed");
+
+    buffer.resize(stream_.total_out);
+    return buffer;
+  }
+
+  z_stream stream_{};
+};
+
+deflate_compressor::deflate_compressor(int level)
+    : impl_{std::make_unique<deflate_compressor::impl>(level)} {}
+
+deflate_compressor::~deflate_compressor() = default;
+
+std::string deflate_compressor::compress(std::string const& input) {
+  return impl_->compress(input);
+}
+
+std::string compress_deflate(std::string const& input, int level) {
+  thread_local std::array<std::unique_ptr<deflate_compressor>,
+                          Z_BEST_COMPRESSION + 1>
+      compressors;
+  utl::verify(level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION,
+              "compress_deflate: invalid level {}", level);
+
+  auto& compressor = compressors[level];
+  if (!compressor) {
+    compressor = std::make_unique<deflate_compressor>(level);
+  }
+  return compressor->compress(input);
+}
+
+constexpr auto const kGzipTrailerSize = 2 * sizeof(uint32_t);  // crc, size
+constexpr auto const kZlibHeaderSize = 2;
+constexpr auto const kZlibTrailerSize = sizeof(uint32_t);  // adler32
+
+std::string compress_tile(std::string const& input, int level) {
+  auto buf = compress_deflate(input, level);
+  append(buf, static_cast<uint32_t>(
+                  crc32(crc32(0L, Z_NULL, 0),
+                        reinterpret_cast<Bytef const*>(input.data()),
+                        static_cast<uInt>(input.size()))));
+  append(buf, static_cast<uint32_t>(input.size()));
+  return buf;
+}
+
+std::string encode_tile(std::string_view tile, content_encoding encoding) {
+  utl::verify(tile.size() >=
+                  kZlibHeaderSize + kZlibTrailerSize + kGzipTrailerSize,
+              "encode_tile: invalid tile");
+  auto const zlib = tile.substr(0, tile.size() - kGzipTrailerSize);
+  auto const trailer = tile.substr(zlib.size());
 
-  auto error = compress2(reinterpret_cast<uint8_t*>(&buffer[0]), &out_size,
-                         reinterpret_cast<uint8_t const*>(&input[0]),
-                         input.size(), Z_BEST_COMPRESSION);
-  utl::verify(error == 0, "compress_deflate failed");
+  switch (encoding) {
+    case content_encoding::deflate: return std::string{zlib};
+    case content_encoding::gzip: {
+      utl::verify((static_cast<uint8_t>(zlib[1]) & 0x20U) == 0,
+                  "encode_tile: zlib preset dictionary");
+      // magic, method=deflate, no flags/mtime, xfl=0, os=unknown
+      std::string buf{"\x1f\x8b\x08\0\0\0\0\0\0\xff", 10};
+      buf.append(zlib.substr(kZlibHeaderSize, zlib.size() - kZlibHeaderSize -
+                                                  kZlibTrailerSize));
+      buf.append(trailer);
+      return buf;
+    }
+    case content_encoding::identity: {
+      std::string buf(read<uint32_t>(trailer.data(), sizeof(uint32_t)), '\0');
+      auto size = static_cast<uLongf>(buf.size());
+      utl::verify(
+          uncompress(reinterpret_cast<Bytef*>(&buf[0]), &size,
+                     reinterpret_cast<Bytef const*>(zlib.data()),
+                     static_cast<uLong>(zlib.size())) == Z_OK &&
+              size == buf.size(),
+          "encode_tile: uncompress failed");
+      return buf;
+    }
+    default: throw utl::fail("encode_tile: unknown content_encoding");
+  }
+}
+
+std::optional<content_encoding> select_content_encoding(
+    std::string_view accept_encoding) {
+  std::optional<double> q_deflate, q_gzip, q_identity, q_any;
+
+  while (!accept_encoding.empty()) {
+    auto const comma = accept_encoding.find(',');
+    auto token = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos
+                          ? std::string_view{}
+                          : accept_encoding.substr(comma + 1);
+
+    auto const trim = [](std::string_view str) {
+      while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+      }
+      while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+      }
+      return str;
+    };
+
+    auto q = 1.;
+    auto const semicolon = token.find(';');
+    if (semicolon != std::string_view::npos) {
+      auto const param = trim(token.substr(semicolon + 1));
+      if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') &&
+          param[1] == '=') {
+        q = std::strtod(std::string{param.substr(2)}.c_str(), nullptr);
+      }
+      token = token.substr(0, semicolon);
+    }
 
-  buffer.resize(out_size);
-  return buffer;
+    std::string name{trim(token)};
+    std::transform(begin(name), end(name), begin(name), [](unsigned char c) {
+      return static_cast<char>(std::tolower(c));
+    });
+    if (name == "deflate") {
+      q_deflate = q;
+    } else if (name == "gzip" || name == "x-gzip") {
+      q_gzip = q;
+    } else if (name == "identity") {
+      q_identity = q;
+    } else if (name == "*") {
+      q_any = q;
+    }
+  }
+
+  // highest q wins, ties: cheapest encoding first
+  std::optional<content_encoding> best;
+  auto best_q = 0.;
+  for (auto const& [encoding, q] :
+       {std::pair{content_encoding::deflate,
+                  q_deflate.value_or(q_any.value_or(0.))},
+        std::pair{content_encoding::gzip, q_gzip.value_or(q_any.value_or(0.))},
+        std::pair{content_encoding::identity,
+                  q_identity.value_or(q_any.value_or(0.))}}) {
+    if (q > best_q) {
+      best = encoding;
+      best_q = q;
+    }
+  }
+
+  // identity is acceptable unless excluded explicitly (or by "*;q=0")
+  if (!best && q_identity.value_or(q_any.value_or(1.)) > 0.) {
+    best = content_encoding::identity;
+  }
+  return best;
+}
+
+char const* to_str(content_encoding const encoding) {
+  switch (encoding) {
+    case content_encoding::deflate: return "deflate";
+    case content_encoding::gzip: return "gzip";
+    case content_encoding::identity: return "identity";
+    default: throw utl::fail("to_str: unknown content_encoding");
+  }
 }
 
 struct regex_matcher::impl {
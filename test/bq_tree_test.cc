@@ -196,6 +196,28 @@ TEST_CASE("bq_tree_all_leafs") {
   }
 }
 
+TEST_CASE("bq_tree_flatten") {
+  auto const tiles = std::vector<geo::tile>{
+      {0, 0, 1}, {4, 5, 3}, {17, 24, 5}, {17, 25, 5}, {90, 100, 7}};
+
+  auto walk_tree = tiles::make_bq_tree(tiles);
+  auto flat_tree = tiles::make_bq_tree(tiles);
+  flat_tree.flatten(3);
+  REQUIRE(flat_tree.flat_.has_value());
+
+  for (auto z = 0U; z <= 9; ++z) {
+    for (auto const& tile : geo::make_tile_range(z)) {
+      CHECK(walk_tree.contains(tile) == flat_tree.contains(tile));
+
+      auto walk_result = walk_tree.all_leafs(tile);
+      auto flat_result = flat_tree.all_leafs(tile);
+      std::sort(begin(walk_result), end(walk_result));
+      std::sort(begin(flat_result), end(flat_result));
+      CHECK(walk_result == flat_result);
+    }
+  }
+}
+
 TEST_CASE("bq_tree_tsv_file", "[!hide]") {
   std::ifstream in("tiles.tsv");
 
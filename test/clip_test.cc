@@ -1,5 +1,7 @@
 #include "catch2/catch.hpp"
 
+#include "boost/geometry.hpp"
+
 #include "tiles/fixed/algo/clip.h"
 
 using namespace tiles;
@@ -63,4 +65,99 @@ TEST_CASE("fixed point polyline") {
     fixed_polyline expected{{{{12, 10}, {12, 12}}}};
     CHECK(mpark::get<fixed_polyline>(result) == expected);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("fixed polygon covers") {
+  fixed_box box{{10, 10}, {20, 20}};
+
+  auto const make_polygon = [](fixed_coord_t min, fixed_coord_t max) {
+    return to_polygon(fixed_box{{min, min}, {max, max}});
+  };
+
+  CHECK(covers(make_polygon(0, 30), box));
+  CHECK_FALSE(covers(make_polygon(0, 15), box));  // partial overlap
+  CHECK_FALSE(covers(make_polygon(12, 18), box));  // inside the box
+  CHECK_FALSE(covers(make_polygon(40, 50), box));  // disjoint
+
+  {
+    auto test_case = make_polygon(0, 30);
+    test_case.front().inners().push_back(
+        make_polygon(12, 18).front().outer());  // hole inside the box
+    boost::geometry::correct(test_case);
+    CHECK_FALSE(covers(test_case, box));
+  }
+
+  {
+    auto test_case = make_polygon(0, 30);
+    test_case.front().inners().push_back(
+        make_polygon(22, 28).front().outer());  // hole outside the box
+    boost::geometry::correct(test_case);
+    CHECK(covers(test_case, box));
+  }
+
+  {
+    auto result = clip(make_polygon(0, 30), box);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    CHECK(boost::geometry::equals(mpark::get<fixed_polygon>(result),
+                                  to_polygon(box)));
+  }
+}
+
+TEST_CASE("fixed polygon union") {
+  auto const make_polygon = [](fixed_coord_t min_x, fixed_coord_t max_x) {
+    return to_polygon(fixed_box{{min_x, 0}, {max_x, 10}});
+  };
+
+  {
+    fixed_polygon test_case = make_polygon(0, 10);
+    test_case.push_back(make_polygon(5, 20).front());  // overlapping
+    test_case.push_back(make_polygon(30, 40).front());  // disjoint
+
+    auto const result = union_polygons(test_case, 0);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    auto const& polygon = mpark::get<fixed_polygon>(result);
+    CHECK(polygon.size() == 2);
+    CHECK(boost::geometry::area(polygon) ==
+          boost::geometry::area(make_polygon(0, 20)) +
+              boost::geometry::area(make_polygon(30, 40)));
+  }
+
+  {
+    fixed_polygon test_case = make_polygon(0, 10);
+    test_case.push_back(make_polygon(10, 20).front());  // adjacent
+
+    auto const result = union_polygons(test_case, 0);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    CHECK(boost::geometry::equals(mpark::get<fixed_polygon>(result),
+                                  make_polygon(0, 20)));
+  }
+}
+
+TEST_CASE("fixed box union") {
+  auto const null_index = fixed_geometry{fixed_null{}}.index();
+  REQUIRE(union_boxes({}).index() == null_index);
+
+  {  // 2x2 grid -> one rectangle without the grid vertices
+    auto const result = union_boxes({fixed_box{{0, 0}, {10, 10}},
+                                     fixed_box{{10, 0}, {20, 10}},
+                                     fixed_box{{0, 10}, {10, 20}},
+                                     fixed_box{{10, 10}, {20, 20}}});
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    auto const& polygon = mpark::get<fixed_polygon>(result);
+    REQUIRE(polygon.size() == 1);
+    CHECK(polygon.front().outer().size() == 5);
+    CHECK(boost::geometry::equals(polygon,
+                                  to_polygon(fixed_box{{0, 0}, {20, 20}})));
+  }
+
+  {  // overlapping (overdraw) L-shape and one disjoint box
+    auto const result = union_boxes({fixed_box{{0, 0}, {12, 10}},
+                                     fixed_box{{8, 0}, {20, 10}},
+                                     fixed_box{{0, 8}, {10, 20}},
+                                     fixed_box{{30, 30}, {40, 40}}});
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    auto const& polygon = mpark::get<fixed_polygon>(result);
+    REQUIRE(polygon.size() == 2);
+    CHECK(boost::geometry::area(polygon) == 20 * 10 + 10 * 10 + 10 * 10);
+  }
+}
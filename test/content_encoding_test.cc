@@ -0,0 +1,98 @@
+#include "catch2/catch.hpp"
+
+#include <random>
+
+#include "zlib.h"
+
+#include "tiles/bin_utils.h"
+#include "tiles/util.h"
+
+using namespace tiles;
+
+std::string inflate_any(std::string const& in, int window_bits) {
+  z_stream stream{};
+  REQUIRE(inflateInit2(&stream, window_bits) == Z_OK);
+
+  std::string out(1024ULL * 1024, '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  stream.avail_in = static_cast<uInt>(in.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  auto const result = inflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+
+  REQUIRE(result == Z_STREAM_END);
+  return out;
+}
+
+TEST_CASE("compress_deflate") {
+  std::string test(1024ULL * 1024, '\0');
+
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<uint64_t> dist;
+  for (auto i = 0ULL; i < test.size(); i += sizeof(uint64_t)) {
+    tiles::write(test.data(), i, dist(gen));
+  }
+
+  auto out = tiles::compress_deflate(test);
+  CHECK_FALSE(out.empty());
+  CHECK(inflate_any(out, MAX_WBITS) == test);
+}
+
+TEST_CASE("compress_deflate levels") {
+  std::string test;
+  for (auto i = 0; i < 1024; ++i) {
+    test.append("tiles are compressed with zlib; ");
+  }
+
+  auto const fast = tiles::compress_deflate(test, tiles::kCompressLevelFast);
+  auto const best = tiles::compress_deflate(test, tiles::kCompressLevelMax);
+  CHECK(inflate_any(fast, MAX_WBITS) == test);
+  CHECK(inflate_any(best, MAX_WBITS) == test);
+  CHECK(best.size() <= fast.size());
+
+  // compressor state is reused -> same result twice
+  CHECK(tiles::compress_deflate(test, tiles::kCompressLevelMax) == best);
+
+  tiles::deflate_compressor compressor{tiles::kCompressLevelMax};
+  CHECK(compressor.compress(test) == best);
+  CHECK(compressor.compress(test) == best);
+  CHECK(inflate_any(compressor.compress(std::string{}), MAX_WBITS).empty());
+}
+
+TEST_CASE("content_encoding encode_tile") {
+  std::string raw;
+  for (auto i = 0; i < 512; ++i) {
+    raw.append("some vector tile bytes ");
+    raw.append(std::to_string(i));
+  }
+
+  auto const tile = compress_tile(raw);
+
+  auto const deflate = encode_tile(tile, content_encoding::deflate);
+  CHECK(inflate_any(deflate, MAX_WBITS) == raw);
+
+  auto const gzip = encode_tile(tile, content_encoding::gzip);
+  CHECK(inflate_any(gzip, MAX_WBITS + 16) == raw);  // +16: gzip only
+
+  CHECK(encode_tile(tile, content_encoding::identity) == raw);
+}
+
+TEST_CASE("content_encoding select") {
+  using ce = content_encoding;
+
+  CHECK(select_content_encoding("") == ce::identity);
+  CHECK(select_content_encoding("gzip, deflate, br") == ce::deflate);
+  CHECK(select_content_encoding("gzip") == ce::gzip);
+  CHECK(select_content_encoding("GZIP;q=0.5, identity") == ce::identity);
+  CHECK(select_content_encoding("GZIP;q=0.5") == ce::gzip);
+  CHECK(select_content_encoding("gzip;q=0.5, deflate;q=1") == ce::deflate);
+  CHECK(select_content_encoding("deflate;q=0.5, gzip") == ce::gzip);
+  CHECK(select_content_encoding("deflate;q=0, gzip") == ce::gzip);
+  CHECK(select_content_encoding("br") == ce::identity);
+  CHECK(select_content_encoding("*") == ce::deflate);
+  CHECK(select_content_encoding("*;q=0, gzip") == ce::gzip);
+  CHECK_FALSE(select_content_encoding("br, *;q=0").has_value());
+  CHECK_FALSE(select_content_encoding("identity;q=0").has_value());
+}
@@ -1,11 +1,48 @@
 #include "catch2/catch.hpp"
 
+#include <algorithm>
+#include <bitset>
+
 #include "tiles/bin_utils.h"
 #include "tiles/db/feature_pack.h"
+#include "tiles/db/feature_pack_filter.h"
 #include "tiles/feature/feature.h"
 #include "tiles/feature/serialize.h"
+#include "tiles/fixed/algo/bounding_box.h"
 #include "tiles/fixed/convert.h"
 #include "tiles/fixed/fixed_geometry.h"
+#include "tiles/mvt/tile_spec.h"
+
+namespace {
+
+// polyline in the (z10) root tile, see tuda_features
+geo::tile const kTudaRoot{536, 347, 10};
+
+tiles::fixed_polyline tuda_line() {
+  return {{tiles::latlng_to_fixed({49.87805785566374, 8.654533624649048}),
+           tiles::latlng_to_fixed({49.87574857815668, 8.657859563827515})}};
+}
+
+// n features on the same line, min zoom levels 0, 5, 10, 0, 5, ...
+std::vector<std::string> tuda_features(uint32_t const n = 3) {
+  std::vector<std::string> features;
+  for (auto i = 0U; i < n; ++i) {
+    features.emplace_back(tiles::serialize_feature(
+        {i, 1, {(i % 3) * 5U, 20U}, {}, tuda_line()}));
+  }
+  return features;
+}
+
+// features of the pack which are visible in tile (via the pack index)
+int count_features(std::string const& pack, geo::tile const& root,
+                   geo::tile const& tile) {
+  auto n = 0;
+  tiles::unpack_features(root, pack, tile, tiles::tile_spec{tile}.draw_bounds_,
+                         [&](auto const&) { ++n; });
+  return n;
+}
+
+}  // namespace
 
 TEST_CASE("feature_pack") {
   SECTION("empty") {
@@ -22,6 +59,7 @@ TEST_CASE("feature_pack") {
     CHECK(count == 0);
 
     tiles::unpack_features(geo::tile{}, pack, geo::tile{},
+                           tiles::tile_spec{geo::tile{}}.draw_bounds_,
                            [&](auto const&) { ++count; });
     CHECK(count == 0);
   }
@@ -47,6 +85,7 @@ TEST_CASE("feature_pack") {
       CHECK(count == 1);
 
       tiles::unpack_features(geo::tile{}, pack, geo::tile{},
+                             tiles::tile_spec{geo::tile{}}.draw_bounds_,
                              [&](auto const&) { ++count; });
       CHECK(count == 2);
     }
@@ -58,15 +97,172 @@ TEST_CASE("feature_pack") {
 
       REQUIRE(pack.size() > 5ULL);
       CHECK(tiles::read_nth<uint32_t>(pack.data(), 0) == 1U);  // feature count
-      CHECK(tiles::read_nth<uint8_t>(pack.data(), 4) == 1U);  // segment count
+      CHECK(tiles::read_nth<uint8_t>(pack.data(), 4) == 4U);  // segment count
 
       auto count = 0;
       tiles::unpack_features(pack, [&](auto const&) { ++count; });
       CHECK(count == 1);
 
       tiles::unpack_features(geo::tile{}, pack, geo::tile{},
+                             tiles::tile_spec{geo::tile{}}.draw_bounds_,
                              [&](auto const&) { ++count; });
       CHECK(count == 2);
     }
   }
 }
+
+TEST_CASE("feature_pack_feature_table") {
+  auto const features = tuda_features();
+
+  SECTION("plain pack") {
+    CHECK(!tiles::find_feature_table(tiles::pack_features(features)));
+  }
+
+  SECTION("quadtree pack") {
+    auto const pack =
+        tiles::pack_features(kTudaRoot, {}, {tiles::pack_features(features)});
+    CHECK(tiles::feature_pack_valid(pack));
+
+    auto const table = tiles::find_feature_table(pack);
+    REQUIRE(table.has_value());
+    REQUIRE(table->size() == 3);
+
+    std::vector<std::string_view> all;
+    tiles::unpack_features(pack, [&](auto const& f) { all.push_back(f); });
+    REQUIRE(all.size() == 3);
+    for (auto i = 0U; i < table->size(); ++i) {
+      CHECK(std::find(begin(all), end(all), table->feature(i)) != end(all));
+      CHECK(table->zoom_levels(i).second == 20U);
+    }
+
+    auto count = 0;
+    tiles::unpack_features(*table, 0, table->size(), 7,
+                           [&](auto const&) { ++count; });
+    CHECK(count == 2);  // min zoom 0 and 5
+
+    count = 0;
+    tiles::unpack_features(*table, 1, 2, 20, [&](auto const&) { ++count; });
+    CHECK(count == 1);
+  }
+}
+
+TEST_CASE("feature_pack_zoom_range_index") {
+  auto const pack = tiles::pack_features(
+      kTudaRoot, {}, {tiles::pack_features(tuda_features())});
+  CHECK(tiles::feature_pack_valid(pack));
+  CHECK(tiles::find_segment_offset(pack, tiles::kZoomRangeIndexId)
+            .has_value());
+
+  auto const count = [&](geo::tile const& tile) {
+    return count_features(pack, kTudaRoot, tile);
+  };
+  CHECK(count(geo::tile{8, 5, 4}) == 1);  // min zoom 0
+  CHECK(count(geo::tile{67, 43, 7}) == 2);  // min zoom 0 and 5
+  CHECK(count(kTudaRoot) == 3);
+}
+
+TEST_CASE("feature_pack_filter") {
+  auto const features = tuda_features();
+  auto const box = tiles::bounding_box(tuda_line());
+
+  SECTION("plain pack") {
+    auto const pack = tiles::pack_features(features);
+    CHECK(!tiles::select_features(pack, {}, 10).has_value());
+    CHECK(!tiles::unpack_selected_features(pack, {}, 10, [](auto const&) {}));
+  }
+
+  SECTION("quadtree pack") {
+    auto const pack =
+        tiles::pack_features(kTudaRoot, {}, {tiles::pack_features(features)});
+
+    auto const selection = tiles::select_features(pack, box, 7);
+    REQUIRE(selection.has_value());
+    REQUIRE(selection->size() == 1);
+    CHECK((*selection)[0] != 0);
+    CHECK((*selection)[0] >> 3 == 0);  // three features
+
+    auto count = 0;
+    CHECK(tiles::unpack_selected_features(pack, box, 7,
+                                          [&](auto const&) { ++count; }));
+    CHECK(count == 2);  // min zoom 0 and 5
+
+    count = 0;
+    CHECK(tiles::unpack_selected_features(pack, box, 20,
+                                          [&](auto const&) { ++count; }));
+    CHECK(count == 3);
+
+    tiles::fixed_box const elsewhere{{box.max_corner().x() + 1, 0},
+                                     {tiles::kFixedCoordMax, 0}};
+    count = 0;
+    CHECK(tiles::unpack_selected_features(pack, elsewhere, 20,
+                                          [&](auto const&) { ++count; }));
+    CHECK(count == 0);
+  }
+
+  SECTION("multiple selection words") {
+    // 150 features: two full words and a partial last one (22 bits)
+    auto const pack = tiles::pack_features(
+        kTudaRoot, {}, {tiles::pack_features(tuda_features(150))});
+
+    auto const bit_count = [](tiles::feature_selection const& s) {
+      auto n = 0ULL;
+      for (auto const word : s) {
+        n += std::bitset<64>(word).count();
+      }
+      return n;
+    };
+
+    // all match: stale matches of the previous block must not leak
+    auto const all = tiles::select_features(pack, box, 20);
+    REQUIRE(all.has_value());
+    REQUIRE(all->size() == 3);
+    CHECK((*all)[0] == ~0ULL);
+    CHECK((*all)[1] == ~0ULL);
+    CHECK((*all)[2] == (1ULL << 22) - 1);
+    CHECK(bit_count(*all) == 150);
+
+    auto const some = tiles::select_features(pack, box, 7);
+    REQUIRE(some.has_value());
+    CHECK(bit_count(*some) == 100);  // min zoom 0 and 5
+    CHECK((*some)[2] >> 22 == 0);
+
+    auto count = 0;
+    CHECK(tiles::unpack_selected_features(pack, box, 7,
+                                          [&](auto const&) { ++count; }));
+    CHECK(count == 100);
+  }
+}
+
+TEST_CASE("feature_pack_hilbert_rtree") {
+  std::vector<std::string> features;
+  for (auto i = 0U; i < 3; ++i) {
+    auto const x = 8.654533624649048 + i * 0.01;
+    features.emplace_back(tiles::serialize_feature(
+        {i,
+         1,
+         {i * 5U, 20U},
+         {},
+         tiles::fixed_polyline{{tiles::latlng_to_fixed({49.878, x}),
+                                tiles::latlng_to_fixed({49.875, x})}}}));
+  }
+
+  geo::tile const root{536, 347, 10};
+  auto const pack =
+      tiles::pack_features(root, {}, {tiles::pack_features(features)},
+                           tiles::pack_index::hilbert_rtree);
+  CHECK(tiles::feature_pack_valid(pack));
+  REQUIRE(tiles::find_segment_offset(pack, tiles::kHilbertRTreeIndexId)
+              .has_value());
+
+  auto const count = [&](geo::tile const& tile) {
+    return count_features(pack, root, tile);
+  };
+  CHECK(count(root) == 3);
+  CHECK(count(geo::tile{67, 43, 7}) == 2);  // min zoom 0 and 5
+  CHECK(count(geo::tile{0, 0, 10}) == 0);
+
+  CHECK(tiles::parse_pack_index(tiles::to_str(
+            tiles::pack_index::hilbert_rtree)) ==
+        tiles::pack_index::hilbert_rtree);
+  CHECK_THROWS(tiles::parse_pack_index("btree"));
+}
@@ -0,0 +1,65 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tiles/db/feature_pyramid.h"
+#include "tiles/feature/feature.h"
+#include "tiles/fixed/algo/clip.h"
+#include "tiles/mvt/tile_spec.h"
+
+using namespace tiles;
+
+TEST_CASE("feature pyramid generalize") {
+  geo::tile const tile{1, 1, 2};
+  auto const& bounds = tile_spec{tile}.insert_bounds_;
+  auto const x = bounds.min_corner().x();
+  auto const y = bounds.min_corner().y();
+  auto const unit = fixed_coord_t{1} << (kMaxZoomLevel - tile.z_);
+
+  std::vector<feature> features;
+  auto const add = [&](size_t layer, std::string name, fixed_geometry geo,
+                       std::vector<metadata> meta = {}) {
+    meta.emplace(begin(meta), "name", std::move(name));
+    features.push_back(feature{features.size(), layer, {0U, kMaxZoomLevel},
+                               std::move(meta), std::move(geo)});
+  };
+
+  // same screen pixel (16 tile units): the point with most metadata wins
+  add(0, "a", fixed_point{{{x + 10, y + 10}}});
+  add(0, "b", fixed_point{{{x + 10 * unit, y + 10 * unit}}},
+      {{"ref", "1"}});
+  add(0, "c", fixed_point{{{x + 20, y + 20}}});
+
+  // other pixel / other layer -> kept
+  add(0, "d", fixed_point{{{x + 20 * unit, y + 10}}});
+  add(2, "e", fixed_point{{{x + 10, y + 10}}});
+
+  // adjacent -> unioned
+  add(1, "p", to_polygon(fixed_box{{x, y}, {x + 100 * unit, y + 100 * unit}}));
+  add(1, "p", to_polygon(fixed_box{{x + 100 * unit, y},
+                                   {x + 200 * unit, y + 100 * unit}}));
+
+  // outside the draw bounds -> dropped
+  add(1, "q", to_polygon(fixed_box{{x - 20000 * unit, y - 20000 * unit},
+                                   {x - 10000 * unit, y - 10000 * unit}}));
+
+  auto const result = generalize_features(std::move(features), tile);
+  std::vector<std::string> point_names;
+  for (auto const& f : result) {
+    if (mpark::holds_alternative<fixed_point>(f.geometry_)) {
+      point_names.push_back(f.meta_.front().value_);
+    }
+  }
+  std::sort(begin(point_names), end(point_names));
+  CHECK(point_names == std::vector<std::string>{"b", "d", "e"});
+
+  REQUIRE(std::count_if(begin(result), end(result), [](auto const& f) {
+            return mpark::holds_alternative<fixed_polygon>(f.geometry_);
+          }) == 1);
+  auto const polygon = std::find_if(begin(result), end(result), [](auto& f) {
+    return mpark::holds_alternative<fixed_polygon>(f.geometry_);
+  });
+  CHECK(mpark::get<fixed_polygon>(polygon->geometry_).size() == 1);
+}
@@ -0,0 +1,69 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+
+#include "tiles/db/hilbert_rtree.h"
+
+using namespace tiles;
+
+std::vector<uint32_t> collect_rtree(std::string const& tree,
+                                    fixed_box const& q, uint32_t z = 20) {
+  std::vector<uint32_t> result;
+  walk_hilbert_rtree(tree.data(), q, z,
+                     [&](auto const p) { result.push_back(p); });
+  std::sort(begin(result), end(result));
+  return result;
+}
+
+TEST_CASE("hilbert_rtree") {
+  SECTION("empty tree") {
+    auto const tree = make_hilbert_rtree({});
+    CHECK(tree.size() == 4);
+    CHECK(collect_rtree(tree, {{0, 0}, {kFixedCoordMax, kFixedCoordMax}})
+              .empty());
+  }
+
+  SECTION("one entry") {
+    auto const tree = make_hilbert_rtree({{{{10, 10}, {20, 20}}, 42U}});
+    CHECK(collect_rtree(tree, {{0, 0}, {15, 15}}) ==
+          std::vector<uint32_t>{42U});
+    CHECK(collect_rtree(tree, {{21, 0}, {30, 30}}).empty());
+  }
+
+  SECTION("zoom levels") {
+    auto const tree = make_hilbert_rtree({{{{10, 10}, {20, 20}}, 1U, {0, 20}},
+                                          {{{10, 10}, {20, 20}}, 2U, {5, 20}},
+                                          {{{10, 10}, {20, 20}}, 3U, {0, 4}}});
+    fixed_box const q{{0, 0}, {15, 15}};
+    CHECK(collect_rtree(tree, q, 2) == std::vector<uint32_t>{1U, 3U});
+    CHECK(collect_rtree(tree, q, 5) == std::vector<uint32_t>{1U, 2U});
+  }
+
+  SECTION("grid") {
+    std::vector<hilbert_rtree_input> input;
+    for (auto x = 0; x < 50; ++x) {
+      for (auto y = 0; y < 50; ++y) {
+        input.push_back({{{x * 100, y * 100}, {x * 100 + 50, y * 100 + 50}},
+                         static_cast<uint32_t>(input.size())});
+      }
+    }
+    auto const tree = make_hilbert_rtree(input);
+
+    for (auto const& q : std::vector<fixed_box>{{{0, 0}, {0, 0}},
+                                                {{60, 60}, {90, 90}},
+                                                {{120, 340}, {1010, 2050}},
+                                                {{-100, -100}, {100000, 10}},
+                                                {{4900, 4900}, {9000, 9000}}}) {
+      std::vector<uint32_t> expected;
+      for (auto const& e : input) {
+        if (!(e.box_.min_corner().x() > q.max_corner().x() ||
+              e.box_.min_corner().y() > q.max_corner().y() ||
+              e.box_.max_corner().x() < q.min_corner().x() ||
+              e.box_.max_corner().y() < q.min_corner().y())) {
+          expected.push_back(e.payload_);
+        }
+      }
+      CHECK(collect_rtree(tree, q) == expected);
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#include "catch2/catch.hpp"
+
+#include "tiles/db/feature_pack.h"
+#include "tiles/db/pack_compression.h"
+#include "tiles/db/pack_file.h"
+#include "tiles/feature/feature.h"
+#include "tiles/feature/serialize.h"
+#include "tiles/fixed/convert.h"
+
+TEST_CASE("pack_compression") {
+  tiles::fixed_polyline tuda{
+      {tiles::latlng_to_fixed({49.87805785566374, 8.654533624649048}),
+       tiles::latlng_to_fixed({49.87574857815668, 8.657859563827515})}};
+
+  std::vector<std::string> features;
+  for (auto i = 0ULL; i < 64; ++i) {
+    features.emplace_back(tiles::serialize_feature(
+        {i, 1, {0U, 20U}, {{"highway", "primary"}, {"name", "Tuda"}}, tuda}));
+  }
+  auto const pack = tiles::pack_features(features);
+  std::string buf;
+
+  SECTION("deflate") {
+    auto const compressed = tiles::compress_pack(pack);
+    CHECK(compressed.size() < pack.size());
+    CHECK(tiles::feature_pack_valid(compressed));
+
+    auto count = 0;
+    tiles::unpack_features(compressed, [&](auto const&) { ++count; });
+    CHECK(count == 0);  // wrapper has no features
+
+    CHECK(tiles::decompress_pack(compressed, buf) == pack);
+  }
+
+  SECTION("deflate with dictionary") {
+    auto const dictionary = tiles::train_pack_dictionary({pack, pack});
+    CHECK(!dictionary.empty());
+    CHECK(dictionary.size() <= 32 * 1024);
+
+    auto const compressed = tiles::compress_pack(pack, dictionary);
+    CHECK(compressed.size() < pack.size());
+    CHECK(tiles::decompress_pack(compressed, buf, dictionary) == pack);
+    CHECK_THROWS(tiles::decompress_pack(compressed, buf));
+  }
+
+  SECTION("uncompressed") {
+    auto const empty = tiles::pack_features({});
+    CHECK(tiles::compress_pack(empty) == empty);  // would not get smaller
+    CHECK(tiles::decompress_pack(empty, buf) == empty);
+    CHECK(tiles::decompress_pack(pack, buf) == pack);
+    CHECK(buf.empty());  // no copy
+  }
+
+  SECTION("pack data") {
+    auto const other = tiles::pack_features(
+        std::vector<std::string>{begin(features), begin(features) + 32});
+    auto const compressed = tiles::compress_pack(pack);
+    auto const compressed_other = tiles::compress_pack(other);
+    REQUIRE(compressed_other.size() < other.size());
+
+    // each keeps its own buffer: the first view stays valid
+    tiles::pack_data const a{compressed, {}};
+    tiles::pack_data const b{compressed_other, {}};
+    CHECK(a.view() == pack);
+    CHECK(b.view() == other);
+
+    tiles::pack_data const c{pack, {}};
+    CHECK(c.view().data() == pack.data());  // uncompressed: no copy
+  }
+}
@@ -49,4 +49,25 @@ TEST_CASE("pack_record") {
     CHECK(
         (deser == std::vector<tiles::pack_record>{{8, 9}, {42, 43}, {88, 99}}));
   }
+
+  SECTION("compact") {
+    std::vector<tiles::pack_record> const records{
+        {1ULL << 40, 1000}, {(1ULL << 40) + 1000, 2000}, {5, 10}};
+    auto const ser = tiles::pack_records_serialize(records);
+    CHECK(ser.size() < 2 * sizeof(tiles::pack_record));
+    CHECK(tiles::pack_records_deserialize(ser) == records);
+  }
+
+  SECTION("legacy") {
+    std::string ser;
+    tiles::append(ser, tiles::pack_record{8, 9});
+    tiles::append(ser, tiles::pack_record{42, 43});
+    CHECK((tiles::pack_records_deserialize(ser) ==
+           std::vector<tiles::pack_record>{{8, 9}, {42, 43}}));
+
+    tiles::pack_records_update(ser, tiles::pack_record{88, 99});
+    CHECK(ser.size() < 3 * sizeof(tiles::pack_record));  // rewritten
+    CHECK((tiles::pack_records_deserialize(ser) ==
+           std::vector<tiles::pack_record>{{8, 9}, {42, 43}, {88, 99}}));
+  }
 }
@@ -0,0 +1,34 @@
+#include "catch2/catch.hpp"
+
+#include "tiles/db/shared_metadata.h"
+#include "tiles/feature/deserialize.h"
+#include "tiles/feature/feature.h"
+#include "tiles/feature/serialize.h"
+#include "tiles/fixed/algo/clip.h"
+
+using namespace tiles;
+
+TEST_CASE("feature area class") {
+  CHECK(area_class(fixed_point{{{10, 10}}}) == kNoAreaClass);
+  CHECK(area_class(fixed_polyline{{{0, 0}, {100, 100}}}) == kNoAreaClass);
+
+  // 100 * 100 fixed units -> area < 2^14
+  auto const polygon = to_polygon(fixed_box{{1000, 1000}, {1100, 1100}});
+  CHECK(area_class(polygon) == 15U);
+
+  CHECK(is_subpixel_area(15U, 10));
+  CHECK(is_subpixel_area(15U, 17));  // 12.5 x 12.5 tile units
+  CHECK_FALSE(is_subpixel_area(15U, 18));  // 25 x 25 tile units
+  CHECK_FALSE(is_subpixel_area(kNoAreaClass, 10));
+
+  shared_metadata_decoder decoder;
+  auto const deserialize_at = [&](size_t layer, uint32_t z) {
+    auto const ser = serialize_feature({42ULL, layer, {0U, 20U}, {}, polygon});
+    return deserialize_feature(ser, decoder, {{0, 0}, {1U << 30, 1U << 30}},
+                               z, false, std::nullopt, true);
+  };
+
+  CHECK_FALSE(deserialize_at(1, 17).has_value());
+  CHECK(deserialize_at(1, 18).has_value());
+  CHECK(deserialize_at(kLayerCoastlineIdx, 17).has_value());
+}
@@ -0,0 +1,70 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "tiles/fixed/algo/make_simplify_mask.h"
+#include "tiles/fixed/algo/simplify.h"
+
+using namespace tiles;
+
+TEST_CASE("simplify polygon") {
+  SECTION("rectangle") {
+    fixed_polygon rect{fixed_simple_polygon{
+        {{0, 0}, {0, 100}, {100, 100}, {100, 0}, {0, 0}}}};
+    auto const result = simplify(rect, 1000);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    CHECK(mpark::get<fixed_polygon>(result).front().outer().size() == 5);
+  }
+
+  SECTION("small notch") {
+    fixed_polygon in{fixed_simple_polygon{{{0, 0},
+                                           {0, 100},
+                                           {50, 100},
+                                           {51, 99},  // tiny notch
+                                           {52, 100},
+                                           {100, 100},
+                                           {100, 0},
+                                           {0, 0}}}};
+    auto const result = simplify(in, 10);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    CHECK(mpark::get<fixed_polygon>(result).front().outer().size() == 5);
+  }
+
+  SECTION("never degenerate") {
+    fixed_polygon in{fixed_simple_polygon{
+        {{0, 0}, {0, 10}, {5, 11}, {10, 10}, {10, 0}, {5, -1}, {0, 0}}}};
+    auto const result = simplify(in, 1000000);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    CHECK(mpark::get<fixed_polygon>(result).front().outer().size() == 4);
+  }
+
+  SECTION("topology safe") {
+    fixed_simple_polygon polygon{
+        {{0, 0}, {0, 100}, {50, 102}, {100, 100}, {100, 0}, {0, 0}}};
+    polygon.inners().push_back({{45, 99}, {50, 101}, {55, 99}, {45, 99}});
+
+    // removing the peak would cross the hole
+    auto const result = simplify(fixed_polygon{polygon}, 1000);
+    REQUIRE(mpark::holds_alternative<fixed_polygon>(result));
+    auto const& outer = mpark::get<fixed_polygon>(result).front().outer();
+    CHECK(outer.size() == 5);  // only (100, 0) is removable
+    CHECK(std::find(begin(outer), end(outer), fixed_xy{50, 102}) !=
+          end(outer));
+  }
+}
+
+TEST_CASE("ring simplify mask") {
+  // one screen pixel at z10: (2^10 fixed units per tile unit * 16)^2 = 2^28
+  auto const inf = std::numeric_limits<double>::infinity();
+  std::vector<double> const areas{
+      inf, std::ldexp(1., 21), std::ldexp(1., 28), std::ldexp(1., 29), inf};
+  auto const mask = make_ring_simplify_mask(areas);
+
+  CHECK(mask[20] == std::vector<bool>{true, true, true, true, true});
+  CHECK(mask[16] == std::vector<bool>{true, true, true, true, true});
+  CHECK(mask[10] == std::vector<bool>{true, false, true, true, true});
+  CHECK(mask[9] == std::vector<bool>{true, false, false, false, true});
+  CHECK(mask[0] == std::vector<bool>{true, false, false, false, true});
+}
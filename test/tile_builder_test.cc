@@ -0,0 +1,87 @@
+#include "catch2/catch.hpp"
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "geo/tile.h"
+
+#include "tiles/feature/feature.h"
+#include "tiles/feature/metadata.h"
+#include "tiles/get_tile.h"
+#include "tiles/mvt/tile_builder.h"
+#include "tiles/util_parallel.h"
+
+using namespace tiles;
+
+namespace {
+
+geo::tile const kTile{134, 86, 8};
+
+// squares in a 8x8 grid per layer, four metadata groups per layer
+// -> several union tasks per layer (see aggregate_polygon_features)
+std::vector<feature> grid_features() {
+  auto const origin_x = static_cast<fixed_coord_t>(kTile.x_) << 24;
+  auto const origin_y = static_cast<fixed_coord_t>(kTile.y_) << 24;
+  auto const cell = fixed_coord_t{1} << 21;
+  auto const size = fixed_coord_t{1} << 20;
+
+  std::vector<feature> features;
+  for (auto layer = 1ULL; layer < 4; ++layer) {
+    for (auto i = 0; i < 64; ++i) {
+      auto const x = origin_x + (i % 8) * cell;
+      auto const y = origin_y + (i / 8) * cell;
+
+      feature f;
+      f.id_ = features.size();
+      f.layer_ = layer;
+      f.zoom_levels_ = {0, kMaxZoomLevel};
+      f.meta_ = {{"kind", encode_string(std::to_string(i % 4))}};
+      f.geometry_ = fixed_polygon{fixed_simple_polygon{{{x, y},
+                                                        {x, y + size},
+                                                        {x + size, y + size},
+                                                        {x + size, y},
+                                                        {x, y}}}};
+      features.emplace_back(std::move(f));
+    }
+  }
+  return features;
+}
+
+std::string render(render_ctx const& ctx) {
+  tile_builder tb{ctx, kTile};
+  for (auto& f : grid_features()) {
+    tb.add_feature(std::move(f));
+  }
+  return tb.finish();
+}
+
+}  // namespace
+
+TEST_CASE("tile builder layer queue") {
+  render_ctx ctx;
+  ctx.layer_names_ = {"coastline", "landuse", "water", "building"};
+  ctx.tb_aggregate_polygons_ = true;
+
+  auto const sequential = render(ctx);
+  REQUIRE(!sequential.empty());
+
+  queue_wrapper<std::function<void()>> queue;
+  queue_processor processor{queue};
+  ctx.tb_layer_queue_ = &queue;
+
+  // concurrent tiles share the queue (like prepare_tiles)
+  std::vector<std::string> results(4);
+  std::vector<std::thread> threads;
+  for (auto i = 0ULL; i < results.size(); ++i) {
+    threads.emplace_back([&, i] { results[i] = render(ctx); });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  for (auto const& result : results) {
+    CHECK(result == sequential);
+  }
+}
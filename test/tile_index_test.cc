@@ -30,3 +30,79 @@ TEST_CASE("tile_index") {
   CHECK(geo::tile{0, 2097151, 0} ==
         tiles::key_to_tile(tiles::tile_to_key(geo::tile{0, 2097151, 0})));
 }
+
+TEST_CASE("tile_index_morton") {
+  using tiles::tile_key_layout;
+
+  std::vector<tiles::tile_key_t> keys;
+  for (geo::tile_iterator it{0}; it->z_ != 6; ++it) {
+    for (auto n : {0UL, 1UL, 131071UL}) {
+      CAPTURE(*it);
+      CAPTURE(n);
+
+      auto const key = tiles::tile_to_key(*it, tile_key_layout::morton, n);
+
+      CHECK(*it == tiles::key_to_tile(key, tile_key_layout::morton));
+      CHECK(n == tiles::key_to_n(key));
+
+      keys.push_back(key);
+    }
+  }
+
+  auto const keys_size = keys.size();
+  utl::erase_duplicates(keys);
+  CHECK(keys_size == keys.size());
+
+  CHECK(geo::tile{2097151, 2097151, 21} ==
+        tiles::key_to_tile(tiles::tile_to_key(geo::tile{2097151, 2097151, 21},
+                                              tile_key_layout::morton),
+                           tile_key_layout::morton));
+
+  // all children on z5 of a tile on z3 are inside its key range
+  for (auto const& parent : geo::make_tile_range(3)) {
+    auto const [key_begin, key_end] = tiles::morton_key_range(parent, 5);
+    for (auto const& child : geo::make_tile_range(5)) {
+      auto const key = tiles::tile_to_key(child, tile_key_layout::morton, 42);
+      auto const inside = (child.x_ >> 2) == parent.x_ &&  //
+                          (child.y_ >> 2) == parent.y_;
+      CHECK(inside == (key_begin <= key && key < key_end));
+    }
+  }
+
+  // deeper query tile -> key range of its parent
+  auto const [key_begin, key_end] =
+      tiles::morton_key_range(geo::tile{8, 12, 7}, 5);
+  CHECK(key_begin ==
+        tiles::tile_to_key(geo::tile{2, 3, 5}, tile_key_layout::morton));
+  CHECK(key_end ==
+        tiles::tile_to_key(geo::tile{3, 3, 5}, tile_key_layout::morton));
+}
+
+TEST_CASE("tile_index_zoom_level") {
+  CHECK(tiles::index_zoom_level(0) == 4);
+  CHECK(tiles::index_zoom_level(4) == 4);
+  CHECK(tiles::index_zoom_level(6) == 4);
+  CHECK(tiles::index_zoom_level(7) == 7);
+  CHECK(tiles::index_zoom_level(10) == 10);
+  CHECK(tiles::index_zoom_level(14) == 10);
+}
+
+TEST_CASE("tile_index_zoom_level_large_feature") {
+  using tiles::fixed_box;
+  auto const z10_tile = tiles::kTileSize << 10;  // fixed coords per z10 tile
+
+  fixed_box const small{{10, 10}, {20, 20}};
+  CHECK(tiles::index_zoom_level(small, 14) == 10);
+  CHECK(tiles::index_zoom_level(small, 5) == 4);
+
+  fixed_box const medium{{0, 0}, {4 * z10_tile - 1, 4 * z10_tile - 1}};
+  CHECK(tiles::index_tile_count(medium, 10) == 16);
+  CHECK(tiles::index_zoom_level(medium, 14) == 10);
+
+  fixed_box const large{{0, 0}, {4 * z10_tile, 4 * z10_tile}};
+  CHECK(tiles::index_tile_count(large, 10) == 25);
+  CHECK(tiles::index_zoom_level(large, 14) == 7);
+
+  fixed_box const huge{{0, 0}, {400 * z10_tile, 10 * z10_tile}};
+  CHECK(tiles::index_zoom_level(huge, 14) == 4);
+}
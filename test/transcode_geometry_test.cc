@@ -0,0 +1,112 @@
+#include "catch2/catch.hpp"
+
+#include "boost/geometry.hpp"
+
+#include "tiles/fixed/algo/shift.h"
+#include "tiles/fixed/io/deserialize.h"
+#include "tiles/fixed/io/serialize.h"
+#include "tiles/mvt/encode_geometry.h"
+
+using namespace tiles;
+namespace pz = protozero;
+namespace ttm = tiles::tags::mvt;
+
+std::string encode_reference(fixed_geometry const& geo,
+                             tile_spec const& spec) {
+  auto const shifted =
+      shift(deserialize(serialize(geo)), spec.tile_.z_, spec.extent_shift_);
+  if (mpark::holds_alternative<fixed_null>(shifted)) {
+    return {};
+  }
+
+  std::string buf;
+  pz::pbf_builder<ttm::Feature> pb{buf};
+  encode_geometry(pb, shifted, spec);
+  return buf;
+}
+
+std::string encode_transcoded(fixed_geometry const& geo,
+                              tile_spec const& spec) {
+  std::string buf;
+  pz::pbf_builder<ttm::Feature> pb{buf};
+  if (!transcode_geometry(pb, serialize(geo), {}, spec)) {
+    return {};
+  }
+  return buf;
+}
+
+TEST_CASE("transcode_geometry") {
+  tile_spec const spec{geo::tile{536, 347, 10}};
+  auto const x = spec.insert_bounds_.min_corner().x();
+  auto const y = spec.insert_bounds_.min_corner().y();
+  auto const s = 1 << 10;  // one pixel on z10
+
+  SECTION("point") {
+    fixed_geometry const a = fixed_point{{x + 10 * s, y + 20 * s}};
+    CHECK(encode_reference(a, spec) == encode_transcoded(a, spec));
+
+    fixed_geometry const b = fixed_point{{x + 10 * s, y + 20 * s},
+                                         {x + 10 * s + 1, y + 20 * s + 1},
+                                         {x + 30 * s, y + 40 * s}};
+    CHECK(encode_reference(b, spec) == encode_transcoded(b, spec));
+  }
+
+  SECTION("polyline") {
+    fixed_geometry const a = fixed_polyline{
+        {{x + 10 * s, y + 20 * s}, {x + 10 * s + 3, y + 20 * s}},  // collapses
+        {{x + 10 * s, y + 20 * s},
+         {x + 30 * s, y + 20 * s},
+         {x + 30 * s + 1, y + 20 * s},
+         {x + 30 * s, y + 50 * s}}};
+    CHECK(encode_reference(a, spec) == encode_transcoded(a, spec));
+
+    fixed_geometry const b = fixed_polyline{
+        {{x + 10 * s, y + 20 * s}, {x + 10 * s + 3, y + 20 * s}}};
+    CHECK(encode_transcoded(b, spec).empty());
+  }
+
+  SECTION("polygon") {
+    fixed_polygon a{{{{x + 10 * s, y + 10 * s},
+                      {x + 10 * s, y + 90 * s},
+                      {x + 90 * s, y + 90 * s},
+                      {x + 90 * s, y + 10 * s},
+                      {x + 10 * s, y + 10 * s}},
+                     {{{x + 20 * s, y + 20 * s},
+                       {x + 40 * s, y + 20 * s},
+                       {x + 40 * s, y + 40 * s},
+                       {x + 20 * s, y + 40 * s},
+                       {x + 20 * s, y + 20 * s}},
+                      {{x + 50 * s, y + 50 * s},  // collapses
+                       {x + 50 * s + 1, y + 50 * s},
+                       {x + 50 * s + 1, y + 50 * s + 1},
+                       {x + 50 * s, y + 50 * s}}}}};
+    boost::geometry::correct(a);
+    CHECK(encode_reference(a, spec) == encode_transcoded(a, spec));
+
+    fixed_polygon b = a;
+    boost::geometry::reverse(b);  // transcoder must correct orientation
+    CHECK(encode_reference(a, spec) == encode_transcoded(b, spec));
+  }
+
+  SECTION("quantized extent") {
+    tile_spec const spec_512{geo::tile{536, 347, 10}, 512};
+    REQUIRE(spec_512.extent_shift_ == 3);
+
+    fixed_geometry const a = fixed_polyline{
+        {{x + 10 * s, y + 20 * s},
+         {x + 11 * s, y + 20 * s},  // same pixel with extent 512
+         {x + 30 * s, y + 20 * s}}};
+    CHECK(encode_reference(a, spec_512) == encode_transcoded(a, spec_512));
+    CHECK(encode_transcoded(a, spec_512).size() <
+          encode_transcoded(a, spec).size());
+
+    fixed_geometry const b = fixed_polygon{{{{x + 10 * s, y + 10 * s},
+                                             {x + 10 * s, y + 13 * s},
+                                             {x + 13 * s, y + 13 * s},
+                                             {x + 13 * s, y + 10 * s},
+                                             {x + 10 * s, y + 10 * s}}}};
+    CHECK(!encode_reference(b, spec).empty());
+    CHECK(encode_reference(b, spec_512).empty());  // degenerate ring
+    CHECK(encode_transcoded(b, spec_512).empty());
+  }
+}